@@ -1,9 +1,11 @@
 #include <iostream>
 #include <ranges>
 #include <algorithm>
+#include <memory>
 #include <ctype.h>
 #include <format>
 #include <imgui.h>
+#include "./cache_writer.h"
 #include "./string_utils.h"
 #include "./repo_reader.h"
 #include "./job_queue.h"
@@ -11,9 +13,34 @@
 #include "./alphabetic_tree.h"
 
 
-Alphabetic_tree::Alphabetic_tree(Conan::Repository_reader& rr):
-    repo_reader{rr}
+auto Info_freshness::ttl(std::string_view remote) const -> std::chrono::seconds
 {
+    auto it = remote_ttls.find(remote);
+    return it != remote_ttls.end() ? it->second : default_ttl;
+}
+
+auto Info_freshness::parse(std::string_view spec) -> Info_freshness
+{
+    Info_freshness freshness;
+    while (!spec.empty()) {
+        auto item = spec.substr(0, spec.find(','));
+        spec.remove_prefix(std::min(spec.size(), item.size() + 1));
+        auto equals = item.find('=');
+        auto seconds = std::chrono::seconds{ std::atoll(std::string{ item.substr(equals + 1) }.c_str()) };
+        if (equals == std::string_view::npos)
+            freshness.default_ttl = seconds;
+        else
+            freshness.remote_ttls[std::string{ item.substr(0, equals) }] = seconds;
+    }
+    return freshness;
+}
+
+Alphabetic_tree::Alphabetic_tree(Conan::Repository_reader& rr, Info_freshness freshness_):
+    repo_reader{rr},
+    freshness{std::move(freshness_)}
+{
+    Job_queue::instance().set_rate_limit(Job_queue::Priority::low, freshness.refresh_rate, info_batch_size);
+
     // TODO: move to Cache_db
     info_query = database.prepare_statement(R"(
         SELECT remote, url, license, description, provides, author, topics, creation_date, last_poll
@@ -22,27 +49,163 @@ Alphabetic_tree::Alphabetic_tree(Conan::Repository_reader& rr):
     )");
 }
 
+Alphabetic_tree::~Alphabetic_tree()
+{
+    // The queued inspect jobs refer to the tree
+    Job_queue::instance().cancel_pending();
+    for (auto& [letter, node] : root)
+        node.references.stop();
+}
+
 void Alphabetic_tree::get_from_database()
 {
     root.clear();
     for (char letter = 'A'; letter <= 'Z'; letter++) root[letter] = {};
 
-    SQLite::Row prev_row = { {" "}, {" "}, {" "}, {" "}, {" "}, {" "} };
+    // Only the per-letter aggregates are obtained at startup (on a separate connection, so the first frame
+    // does not have to wait); the children of every node are fetched the first time it is opened.
+    fetch_letter_aggregates();
+    fetch_topic_facets();
+}
+
+void Alphabetic_tree::fetch_letter_aggregates()
+{
+    letter_aggregates = std::async(std::launch::async, []() {
+        Cache_db db;
+        return db.get_letter_aggregates();
+    });
+}
+
+void Alphabetic_tree::fetch_topic_facets()
+{
+    topic_facets = std::async(std::launch::async, []() {
+        Cache_db db;
+        return db.get_topic_facets();
+    });
+}
+
+auto Alphabetic_tree::get_letter_changes(char letter, const Letter_scan& scan) -> Letter_changes
+{
+    Cache_db db;
+    Letter_changes changes;
+
+    // Only the packages that are new or gone need to be looked at: the ones found again did not change. The
+    // aggregates are obtained for every node on the path of such a package.
+    auto added = db.get_added_packages(letter, scan.marker);
+    changes.added = static_cast<int64_t>(added.size());
+    changes.refreshed = db.count_refreshed_packages(letter, scan.marker);
+    changes.removed = static_cast<int64_t>(scan.result.removed.size());
+    changes.resumed = scan.result.resumed;
+    changes.failures = scan.result.failures;
+
+    auto get_aggregates = [&](const Package_list_entry& package) -> Letter_changes::Channel_path {
+        auto& remote = package.remote;
+        auto& [name, user, channel, version] = package.reference;
+        if (!changes.remotes.contains(name)) {
+            changes.references[name] = db.get_reference_aggregate(name);
+            changes.remotes[name] = db.get_remote_aggregates(name);
+        }
+        if (auto path = Letter_changes::Remote_path{ name, remote }; !changes.users.contains(path))
+            changes.users[path] = db.get_user_aggregates(name, remote);
+        if (auto path = Letter_changes::User_path{ name, remote, user }; !changes.channels.contains(path))
+            changes.channels[path] = db.get_channel_aggregates(name, remote, user);
+        return { name, remote, user, channel };
+    };
+
+    for (auto& package : added)
+        changes.packages[get_aggregates(package)].push_back({ .pkg_id = package.id, .version = package.reference.version });
+    for (auto& package : scan.result.removed)
+        changes.removed_packages[get_aggregates(package)].push_back(package.id);
+
+    return changes;
+}
+
+// Inserts a child node (in label order), or updates its summary if it exists - in which case the node keeps its
+// identity and whatever was loaded below it.
+template <typename Node>
+static auto patch_child(Alphabetic_tree::Lazy_children<Node>& children, const Tree_aggregate& aggregate) -> Node&
+{
+    auto& nodes = children.nodes;
+    auto it = std::lower_bound(nodes.begin(), nodes.end(), aggregate.label,
+        [](const Node& node, const std::string& label) { return node.summary.label < label; });
+    if (it != nodes.end() && it->summary.label == aggregate.label)
+        it->summary = aggregate;
+    else
+        it = nodes.insert(it, Node{ aggregate });
+    return *it;
+}
+
+// Removes the child nodes that are no longer in the (complete, ordered) list of aggregates of their parent
+template <typename Node>
+static void remove_gone_children(Alphabetic_tree::Lazy_children<Node>& children, const std::vector<Tree_aggregate>& aggregates)
+{
+    std::erase_if(children.nodes, [&](const Node& node) {
+        auto it = std::lower_bound(aggregates.begin(), aggregates.end(), node.summary.label,
+            [](const Tree_aggregate& aggregate, const std::string& label) { return aggregate.label < label; });
+        return it == aggregates.end() || it->label != node.summary.label;
+    });
+}
+
+// Same order as Cache_db::get_versions(): SEMVER_KEY(version) DESC, version DESC (non-semantic versions last)
+static void insert_package(std::vector<Alphabetic_tree::Package_node>& packages, Alphabetic_tree::Package_node package)
+{
+    // The channel may have been loaded after the scan inserted the package
+    if (std::any_of(packages.begin(), packages.end(), [&](auto& p) { return p.pkg_id == package.pkg_id; })) return;
 
-    database.get_list(
-        [this, &prev_row](SQLite::Row row) {
-            auto ch = std::get<3>(row[1])[0];
-            auto ch_uc = toupper(ch);
-            auto& letter = root[ch_uc];
-            add_row_to_references_list(letter.references, row, prev_row);
-            prev_row = row;
-            return true;
+    auto newer = [](const auto& a, const auto& b) {
+        return std::pair{ semver_key(a.version), a.version } > std::pair{ semver_key(b.version), b.version };
+    };
+    auto it = std::upper_bound(packages.begin(), packages.end(), package, newer);
+    packages.insert(it, std::move(package));
+}
+
+void Alphabetic_tree::apply_letter_changes(Letter_node& letter, Letter_changes& changes)
+{
+    // Only what has been loaded needs patching, the rest will be up to date when it gets opened
+    if (!letter.references.loaded) return;
+
+    for (auto& [name, aggregate] : changes.references) {
+        if (!aggregate) {
+            std::erase_if(letter.references.nodes, [&name](auto& node) { return node.summary.label == name; });
+            continue;
+        }
+        auto& reference = patch_child(letter.references, *aggregate);
+        if (!reference.remotes.loaded) continue;
+        remove_gone_children(reference.remotes, changes.remotes[name]);
+        for (auto& remote_aggregate : changes.remotes[name]) {
+            auto& remote = patch_child(reference.remotes, remote_aggregate);
+            auto& remote_name = remote.summary.label;
+            if (!remote.users.loaded) continue;
+            remove_gone_children(remote.users, changes.users[{ name, remote_name }]);
+            for (auto& user_aggregate : changes.users[{ name, remote_name }]) {
+                auto& user = patch_child(remote.users, user_aggregate);
+                auto& user_name = user.summary.label;
+                if (!user.channels.loaded) continue;
+                remove_gone_children(user.channels, changes.channels[{ name, remote_name, user_name }]);
+                for (auto& channel_aggregate : changes.channels[{ name, remote_name, user_name }]) {
+                    auto& channel = patch_child(user.channels, channel_aggregate);
+                    if (!channel.packages.loaded) continue;
+                    auto path = Letter_changes::Channel_path{ name, remote_name, user_name, channel.summary.label };
+                    for (auto pkg_id : changes.removed_packages[path])
+                        std::erase_if(channel.packages.nodes, [pkg_id](auto& package) { return package.pkg_id == pkg_id; });
+                    for (auto& package : changes.packages[path])
+                        insert_package(channel.packages.nodes, std::move(package));
+                }
+            }
         }
-    );
+    }
 }
 
 void Alphabetic_tree::draw()
 {
+    if (letter_aggregates.valid() && letter_aggregates.wait_for(std::chrono::milliseconds(0)) == std::future_status::ready) {
+        auto aggregates = letter_aggregates.get();
+        for (auto& [letter, node] : root) {
+            auto it = aggregates.find(letter);
+            node.summary = it != aggregates.end() ? it->second : Tree_aggregate{ std::string{letter} };
+        }
+    }
+
     if (!full_scan.running()) {
         if (ImGui::Button("Re-read all repositories")) {
             // TODO: queue scans for all nodes
@@ -51,51 +214,137 @@ void Alphabetic_tree::draw()
         gui::FormattedText("Full-scan underway (scanning letter {:c})", full_scan.current_letter.load());
     }
 
-    for (auto& it : root) {
-        draw_letter_node(it.first, it.second);
+    draw_topic_facets();
+
+    if (topic_filter.empty()) {
+        for (auto& it : root) {
+            draw_letter_node(it.first, it.second);
+        }
+    }
+    else
+        draw_topic_references();
+
+    queue_info_requests(missing_info, Job_queue::Priority::normal);
+    queue_info_requests(stale_info, Job_queue::Priority::low, true);
+}
+
+void Alphabetic_tree::queue_info_requests(std::vector<Info_request>& requests, Job_queue::Priority priority, bool bypass_cache)
+{
+    for (auto first = requests.begin(); first != requests.end();) {
+        auto last = first + std::min<ptrdiff_t>(info_batch_size, requests.end() - first);
+        auto cost = static_cast<double>(last - first);
+        Job_queue::instance().queue_job(
+            [this, batch = std::vector<Info_request>(first, last), bypass_cache]() {
+                std::vector<Package_key> keys;
+                for (auto& request : batch)
+                    keys.push_back(request.key);
+                // (Failed inspects leave the info that was there alone)
+                auto infos = repo_reader.try_get_infos(keys, bypass_cache);
+                // (If the info cannot be stored, it is still shown, and fetched again once reloaded from the cache)
+                try {
+                    Cache_writer::instance().write([&](Cache_db& db) {
+                        for (auto i = 0U; i < batch.size(); i++)
+                            if (infos[i]) db.upsert_package_info(batch[i].pkg_id, *infos[i]);
+                    }).get();
+                }
+                catch (const std::exception& e) {
+                    std::cerr << "***Storing package info failed: " << e.what() << std::endl;
+                }
+                for (auto i = 0U; i < batch.size(); i++)
+                    batch[i].promise->set_value(infos[i]);
+            },
+            priority, cost
+        );
+        first = last;
     }
+    requests.clear();
 }
 
-void Alphabetic_tree::add_row_to_references_list(References_list& ref_list, const SQLite::Row& row, const SQLite::Row& prev_row)
+static void draw_summary(const Tree_aggregate& summary, std::string_view children_name)
 {
-    auto& reference = std::get<3>(row[1]);
-    auto& remote    = std::get<3>(row[2]);
-    auto& user      = std::get<3>(row[3]);
-    auto& channel   = std::get<3>(row[4]);
-    auto& version   = std::get<3>(row[5]);
-
-    bool changed = false;
-    if (reference != std::get<3>(prev_row[1])) changed = true;
-    if (changed) ref_list.push_back({ reference, Reference_node{} });
-    auto& remote_list = ref_list.back().second.remotes;
-    changed = changed || remote != std::get<3>(prev_row[2]);
-    if (changed) remote_list.push_back({ remote, Remote_node{} });
-    auto& user_list = remote_list.back().second.users;
-    changed = changed || user != std::get<3>(prev_row[3]);
-    if (changed) user_list.push_back({ user, User_node{} });
-    auto& channel_list = user_list.back().second.channels;
-    changed = changed || channel != std::get<3>(prev_row[4]);
-    if (changed) channel_list.push_back({ channel, Channel_node() });
-    auto& package_list = channel_list.back().second.packages;
-    changed = changed || version != std::get<3>(prev_row[5]);
-    if (changed) package_list.push_back({});
-
-    auto& package_node = package_list.back();
-
-    package_node.pkg_id = std::get<1>(row[0]);
-    package_node.version = version;
+    ImGui::SameLine();
+    if (summary.latest.empty())
+        ImGui::TextDisabled("(%lld %s, %lld versions)", (long long)summary.children, children_name.data(), (long long)summary.versions);
+    else
+        ImGui::TextDisabled("(%lld %s, %lld versions, latest %s)", (long long)summary.children, children_name.data(), (long long)summary.versions, summary.latest.c_str());
+}
+
+auto Alphabetic_tree::package_node_from_row(const Package_row& row) -> Package_node
+{
+    Package_node package_node;
+
+    package_node.pkg_id = row.id;
+    package_node.version = row.version;
 
     // Do we have description (non-null) ? then we have the package info
-    if (row[6].index() == 3) {
+    if (row.description) {
         package_node.pkg_info = Package_info {
-            .description = std::get<3>(row[6]),
-            .license     = row[ 7].index() == 0 ? "" : std::get<3>(row[7]),
-            .provides    = row[ 8].index() == 0 ? "" : std::get<3>(row[8]),
-            .author      = row[ 9].index() == 0 ? "" : std::get<3>(row[9]),
-            .topics      = parseTagList(row[10].index() == 3 ? std::get<3>(row[10]) : ""),
-            // .creation_date = std::get<3>(row[11])
+            .description = std::string{ *row.description },
+            .license     = std::string{ row.license },
+            .provides    = std::string{ row.provides },
+            .author      = std::string{ row.author },
         };
+        if (row.info_age)
+            package_node.info_time = std::chrono::steady_clock::now() - std::chrono::seconds{ *row.info_age };
     }
+
+    return package_node;
+}
+
+void Alphabetic_tree::draw_topic_facets()
+{
+    if (topic_facets.valid() && topic_facets.wait_for(std::chrono::milliseconds(0)) == std::future_status::ready)
+        facets = topic_facets.get();
+
+    auto open = ImGui::TreeNode("Topics");
+    // (Counted again every time the list is opened, as the crawler keeps adding info)
+    if (ImGui::IsItemToggledOpen() && open) fetch_topic_facets();
+    if (!topic_filter.empty()) {
+        ImGui::SameLine();
+        gui::FormattedText("(showing \"{0}\")", topic_filter);
+        ImGui::SameLine();
+        if (ImGui::SmallButton("Show all")) topic_filter.clear();
+    }
+    if (!open) return;
+
+    if (topic_facets.valid())
+        ImGui::TextUnformatted("(counting...)");
+
+    // (There can be thousands of them)
+    ImGuiListClipper clipper;
+    clipper.Begin(static_cast<int>(facets.size()));
+    while (clipper.Step()) {
+        for (auto i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+            auto& facet = facets[i];
+            auto label = std::format("{0} ({1} versions)###{0}", facet.topic, facet.packages);
+            if (ImGui::Selectable(label.c_str(), facet.topic == topic_filter) && facet.topic != topic_filter) {
+                topic_filter = facet.topic;
+                topic_references = {};
+            }
+        }
+    }
+    ImGui::TreePop();
+}
+
+void Alphabetic_tree::draw_topic_references()
+{
+    auto loaded = topic_references.load([topic = topic_filter]() {
+        Cache_db db;
+        std::vector<Reference_node> references;
+        for (auto& aggregate : db.get_topic_references(topic))
+            references.push_back({ std::move(aggregate) });
+        return references;
+    });
+    if (!loaded) {
+        ImGui::TextUnformatted("(loading...)");
+        return;
+    }
+
+    gui::FormattedText("{0} references", topic_references.nodes.size());
+    ImGui::PushID(topic_filter.c_str());
+    for (auto& reference : topic_references.nodes)
+        draw_reference(reference);
+    ImGui::PopID();
 }
 
 void Alphabetic_tree::draw_letter_node(char letter, Letter_node& node)
@@ -105,41 +354,64 @@ void Alphabetic_tree::draw_letter_node(char letter, Letter_node& node)
     ImGui::AlignTextToFramePadding();
     auto open = ImGui::TreeNode(std::string{letter}.c_str());
     if (!open) ImGui::PushID(&letter, &letter + 1);
+
+    if (!node.summary.label.empty())
+        draw_summary(node.summary, "references");
     ImGui::SameLine();
 
     // Are we scanning this letter ?
-    if (node.scanning()) {
-        if (node.scan_done()) {
-            (void)node.scan.get();
-            node.temp_packages.clear(); // just in case
-            // Start the database fetch operation
-            node.fetch = std::async(
-                std::launch::async,
-                [this, letter, &node]() {
-                    Cache_db db;
-                    SQLite::Row prev_row = { {" "}, {" "}, {" "}, {" "}, {" "}, {" "} };
-                    db.get_list(
-                        [this, &node, &prev_row](SQLite::Row row) {
-                            add_row_to_references_list(node.temp_packages, row, prev_row);
-                            prev_row = row;
-                            return true;
-                        },
-                        std::format("{0}%", letter)
-                    );     
-                }
-            );
+    if (node.scan.valid() && node.scan.wait_for(std::chrono::milliseconds(0)) == std::future_status::ready) {
+        auto scan = node.scan.get();
+        if (!scan.error.empty()) {
+            node.last_scan = "(scan failed)";
+            node.last_scan_failures = scan.error;
+        }
+        else {
+            // Work out what the scan changed (on a separate connection)
+            node.changes = std::async(std::launch::async, [letter, scan = std::move(scan)]() {
+                return get_letter_changes(letter, scan);
+            });
         }
     }
+    if (node.changes.valid() && node.changes.wait_for(std::chrono::milliseconds(0)) == std::future_status::ready) {
+        auto changes = node.changes.get();
+        apply_letter_changes(node, changes);
+        fetch_letter_aggregates();
+        node.last_scan = std::format("({0} new, {1} found again, {2} removed", changes.added, changes.refreshed, changes.removed);
+        if (changes.resumed > 0) node.last_scan += std::format(", {0} searches resumed", changes.resumed);
+        if (!changes.failures.empty()) node.last_scan += std::format("; {0} remote(s) incomplete, will resume", changes.failures.size());
+        node.last_scan += ")";
+        node.last_scan_failures.clear();
+        for (auto& [remote, failure] : changes.failures)
+            node.last_scan_failures += std::format("{0}{1}: {2}", node.last_scan_failures.empty() ? "" : "\n", remote, failure);
+    }
     if (!full_scan.running()) {
         if (!node.scanning()) {
             if (ImGui::Button("Re-scan")) {
+                // Shift-click: do not use the cached search results
                 node.scan = std::async(
                     std::launch::async, 
-                    [this, letter]() { 
-                        repo_reader.read_letter_all_repositories(letter);
+                    [this, letter, bypass_cache = ImGui::GetIO().KeyShift]() { 
+                        Letter_scan scan;
+                        try {
+                            Cache_db db;
+                            scan.marker = db.get_scan_marker();
+                            scan.result = repo_reader.read_letter_all_repositories(letter, bypass_cache);
+                        }
+                        catch (const std::exception& e) {
+                            std::cerr << "***Scan of letter " << letter << " failed: " << e.what() << std::endl;
+                            scan.error = e.what();
+                        }
+                        return scan;
                     }
                 );
             }
+            else if (!node.last_scan.empty()) {
+                ImGui::SameLine();
+                ImGui::TextDisabled("%s", node.last_scan.c_str());
+                if (!node.last_scan_failures.empty() && ImGui::IsItemHovered())
+                    ImGui::SetTooltip("%s", node.last_scan_failures.c_str());
+            }
         }
         else 
             ImGui::TextUnformatted("(scanning...)");
@@ -147,60 +419,136 @@ void Alphabetic_tree::draw_letter_node(char letter, Letter_node& node)
     else 
         ImGui::TextUnformatted("(Full scan running...)");
 
-    if (node.fetching()) {
-        if (node.fetching_done()) {
-            (void)node.fetch.get();
-            node.references = std::move(node.temp_packages);
-        }
-    }
-
     if (open) {
-        for (auto& it : node.references) {
-            package = it.first;
-            draw_reference(it.first.c_str(), it.second);
+        // (Streamed: a letter can have thousands of references)
+        auto loaded = node.references.load_pages([letter](Cache_db& db, std::string& cursor, size_t page_size) {
+            std::vector<Reference_node> references;
+            for (auto& aggregate : db.get_reference_page(letter, cursor, page_size))
+                references.push_back({ std::move(aggregate) });
+            if (!references.empty()) cursor = references.back().summary.label;
+            return references;
+        });
+        for (auto& reference : node.references.nodes) {
+            draw_reference(reference);
         }
+        if (!loaded)
+            ImGui::TextUnformatted("(loading...)");
         ImGui::TreePop();
-    } else 
+    } else {
+        node.references.stop();
         ImGui::PopID();
+    }
 }
 
-void Alphabetic_tree::draw_reference(const char* pkg_name, Reference_node& node)
+void Alphabetic_tree::draw_reference(Reference_node& node)
 {
-    if (ImGui::TreeNode(pkg_name)) {
-        for (auto& it : node.remotes) {
-            remote = it.first;
-            draw_remote(it.first.c_str(), it.second);
+    package = node.summary.label;
+
+    auto open = ImGui::TreeNode(package.c_str());
+    draw_summary(node.summary, "remotes");
+
+    if (open) {
+        auto loaded = node.remotes.load([name = package]() {
+            Cache_db db;
+            std::vector<Remote_node> remotes;
+            for (auto& aggregate : db.get_remote_aggregates(name))
+                remotes.push_back({ std::move(aggregate) });
+            return remotes;
+        });
+        if (!loaded)
+            ImGui::TextUnformatted("(loading...)");
+        for (auto& it : node.remotes.nodes) {
+            draw_remote(it);
         }
         ImGui::TreePop();
     }
 }
 
-void Alphabetic_tree::draw_remote(const char* version, Remote_node& node)
+void Alphabetic_tree::draw_remote(Remote_node& node)
 {
-    if (ImGui::TreeNode(version)) {
-        for (auto& it : node.users) {
-            user = it.first;
-            draw_user(it.first.c_str(), it.second);
+    remote = node.summary.label;
+
+    auto open = ImGui::TreeNode(remote.c_str());
+    draw_summary(node.summary, "users");
+
+    if (open) {
+        auto loaded = node.users.load([name = package, remote = remote]() {
+            Cache_db db;
+            std::vector<User_node> users;
+            for (auto& aggregate : db.get_user_aggregates(name, remote))
+                users.push_back({ std::move(aggregate) });
+            return users;
+        });
+        if (!loaded)
+            ImGui::TextUnformatted("(loading...)");
+        for (auto& it : node.users.nodes) {
+            draw_user(it);
         }
         ImGui::TreePop();
     }
 }
 
-void Alphabetic_tree::draw_user(const char* version, User_node& node)
+void Alphabetic_tree::draw_user(User_node& node)
 {
-    if (ImGui::TreeNode(version)) {
-        for (auto& it: node.channels) {
-            channel = it.first;
-            draw_channel(it.first.c_str(), it.second);
+    user = node.summary.label;
+
+    auto open = ImGui::TreeNode(user.c_str());
+    draw_summary(node.summary, "channels");
+
+    if (open) {
+        auto loaded = node.channels.load([name = package, remote = remote, user = user]() {
+            Cache_db db;
+            std::vector<Channel_node> channels;
+            for (auto& aggregate : db.get_channel_aggregates(name, remote, user))
+                channels.push_back({ std::move(aggregate) });
+            return channels;
+        });
+        if (!loaded)
+            ImGui::TextUnformatted("(loading...)");
+        for (auto& it: node.channels.nodes) {
+            draw_channel(it);
         }
         ImGui::TreePop();
     }
 }
 
-void Alphabetic_tree::draw_channel(const char* version, Channel_node& node)
+void Alphabetic_tree::draw_channel(Channel_node& node)
 {
-    if (ImGui::TreeNode(version)) {
-        for (auto& package: node.packages) {
+    channel = node.summary.label;
+
+    auto open = ImGui::TreeNode(channel.c_str());
+    ImGui::SameLine();
+    if (node.summary.latest.empty())
+        ImGui::TextDisabled("(%lld versions)", (long long)node.summary.versions);
+    else
+        ImGui::TextDisabled("(%lld versions, latest %s)", (long long)node.summary.versions, node.summary.latest.c_str());
+
+    if (open) {
+        auto loaded = node.packages.load([name = package, remote = remote, user = user, channel = channel]() {
+            Cache_db db;
+            std::vector<Package_node> packages;
+            db.get_versions(
+                [&packages](const Package_row& row) {
+                    packages.push_back(package_node_from_row(row));
+                    return true;
+                },
+                name, remote, user, channel
+            );
+            // (The topics and the attributes of all the versions in one query each)
+            std::vector<int64_t> pkg_ids;
+            for (auto& package: packages)
+                if (package.pkg_info) pkg_ids.push_back(package.pkg_id);
+            auto topics = db.get_topics(pkg_ids);
+            auto attributes = db.get_attributes(pkg_ids);
+            for (auto& package: packages) {
+                if (auto it = topics.find(package.pkg_id); it != topics.end()) package.pkg_info->topics = std::move(it->second);
+                if (auto it = attributes.find(package.pkg_id); it != attributes.end()) package.pkg_info->attributes = std::move(it->second);
+            }
+            return packages;
+        });
+        if (!loaded)
+            ImGui::TextUnformatted("(loading...)");
+        for (auto& package: node.packages.nodes) {
             draw_package(package);
         }
         ImGui::TreePop();
@@ -223,21 +571,33 @@ void Alphabetic_tree::draw_package(Package_node& node)
         ImGui::TextUnformatted("(Full scan running...)");
     else {
         if (node.get_info_fut.valid()) {
-            ImGui::TextUnformatted("(Querying...)");
+            ImGui::TextUnformatted(node.pkg_info ? "(Refreshing...)" : "(Querying...)");
         }
         else {
             requery = ImGui::Button("Re-query");
+            if (ImGui::IsItemHovered()) ImGui::SetTooltip("Shift-click to bypass the response cache");
         }
     }
 
     ImGui::SameLine();
-    ImGui::TextUnformatted(node.pkg_info ? node.pkg_info->description.c_str() : "(please wait...)");
+    ImGui::TextUnformatted(node.pkg_info ? node.pkg_info->description.c_str() : node.info_failed ? "(query failed)" : "(please wait...)");
 
     if (open) {
         if (node.pkg_info) {
             const auto& info = node.pkg_info.value();
             ImGui::Text("License: %s", info.license.c_str());
             ImGui::Text("Topics: %s", join_strings(info.topics, ", ").c_str());
+            // (Whatever else was inspected; multi-line values, such as the options, below their name)
+            for (auto& [key, value]: info.attributes) {
+                if (value.find('\n') == std::string::npos)
+                    ImGui::Text("%s: %s", key.c_str(), value.c_str());
+                else {
+                    ImGui::Text("%s:", key.c_str());
+                    ImGui::Indent();
+                    ImGui::TextUnformatted(value.c_str());
+                    ImGui::Unindent();
+                }
+            }
         }
         else {
             ImGui::TextUnformatted("(please wait...)");
@@ -245,41 +605,31 @@ void Alphabetic_tree::draw_package(Package_node& node)
         ImGui::TreePop();
     }
 
-    if (requery || !node.pkg_info) {
+    // Stale info is shown while it is being refreshed
+    auto stale = node.pkg_info && (!node.info_time || std::chrono::steady_clock::now() - *node.info_time > freshness.ttl(remote));
+
+    if (requery || (!node.pkg_info && !node.info_failed) || stale) {
         if (requery) 
             node.get_info_fut = {};
         if (!node.get_info_fut.valid()) {
-            node.get_info_fut = node.get_info_prom.get_future();
-            Job_queue::instance().queue_job(
-                [this](Package_key key, int64_t pkg_id, std::promise<Package_info>& promise) {
-                    return [this, key, pkg_id, &promise]() {
-                        auto info = repo_reader.get_info(key);
-                        Cache_db db;
-                        db.upsert_package_info(pkg_id, info);
-                        promise.set_value(info);
-                    };
-                } (
-                    Package_key{ remote, package, user, channel, version },
-                    node.pkg_id,
-                    node.get_info_prom
-                )
-            );
-            // node.get_info_fut = std::async(
-            //     std::launch::async,
-            //     [this, &node](const Package_key key, int64_t pkg_id) {
-            //         auto info = repo_reader.get_info(key);
-            //         Cache_db db;
-            //         db.upsert_package_info(pkg_id, info);
-            //         return info;
-            //     },
-            //     Package_key{ remote, package, user, channel, version },
-            //     node.pkg_id
-            // );
+            auto promise = std::make_shared<std::promise<std::optional<Package_info>>>();
+            node.get_info_fut = promise->get_future();
+            Info_request request{ Package_key{ remote, package, user, channel, version }, node.pkg_id, promise };
+            if (requery) {
+                std::vector<Info_request> requests{ request };
+                queue_info_requests(requests, Job_queue::Priority::high, ImGui::GetIO().KeyShift);
+            }
+            else
+                (node.pkg_info ? stale_info : missing_info).push_back(std::move(request));
         }
     }
 
     if (node.get_info_fut.valid() && node.get_info_fut.wait_for(std::chrono::milliseconds(0)) == std::future_status::ready) {
-        node.pkg_info = node.get_info_fut.get();
+        // A failed refresh keeps the stale info (until the next refresh is due)
+        auto info = node.get_info_fut.get();
+        node.info_failed = !info;
+        if (info) node.pkg_info = std::move(info);
+        node.info_time = std::chrono::steady_clock::now();
     }
 
     ImGui::PopID();
@@ -1,84 +1,178 @@
 #pragma once
 
 #include <vector>
-#include <forward_list>
 #include <string>
 #include <future>
+#include <map>
+#include <tuple>
+#include <memory>
+#include <chrono>
+#include <optional>
+#include <atomic>
+#include <mutex>
+#include <iterator>
 #include "./async_data.h"
 #include "./types.h"
 #include "./cache_db.h"
+#include "./job_queue.h"
+#include "./repo_reader.h"
 
 
-struct Alphabetic_tree {
+// When package info is considered stale: stale info is still shown, but refreshed in the background, at a
+// limited rate.
+struct Info_freshness {
+    std::chrono::seconds                        default_ttl = std::chrono::hours{ 24 * 7 };
+    std::map<std::string, std::chrono::seconds, std::less<>> remote_ttls;
+    double                                      refresh_rate = 1;   // background inspects per second
 
-    struct Reference_node;
-    struct Remote_node;
-    struct User_node;
-    struct Channel_node;
-    struct Package_node;
+    auto ttl(std::string_view remote) const -> std::chrono::seconds;
 
-    using References_list = std::vector<std::pair<std::string, Reference_node>>;
+    // "SECONDS[,REMOTE=SECONDS...]", e.g. "604800,internal=3600"
+    static auto parse(std::string_view spec) -> Info_freshness;
+};
 
-    struct Letter_node {
-        References_list references;
-        std::future<void> scan;     // Repo Reader
-        std::future<void> fetch;    // Cache DB
-        References_list temp_packages;
+struct Alphabetic_tree {
 
-        bool scanning() const { return scan.valid(); }
-        bool scan_done() const { return scan.wait_for(std::chrono::milliseconds(0)) == std::future_status::ready; }
+    // Children of a tree node; they are fetched from the cache (on a separate connection) the first time
+    // the node is opened, while the node itself only carries the aggregates obtained with its parent.
+    template <typename Node>
+    struct Lazy_children {
+        std::vector<Node> nodes;
+        std::future<std::vector<Node>> pending;
+        bool loaded = false;
+
+        bool fetching() const { return pending.valid() || streaming.valid(); }
+
+        // Starts fetch() if the children have not been loaded yet; moves them in once they are ready.
+        template <typename Fetch>
+        bool load(Fetch fetch) {
+            if (!loaded && !fetching()) pending = std::async(std::launch::async, fetch);
+            if (fetching() && pending.wait_for(std::chrono::milliseconds(0)) == std::future_status::ready) {
+                nodes = pending.get();
+                loaded = true;
+            }
+            return loaded;
+        }
+
+        // Same, page by page: fetch_page(db, cursor, page_size) returns the page that follows the cursor, and
+        // advances the cursor. The pages are shown as they arrive; stop() ends the fetch after the current page
+        // (e.g. when the node gets closed), and the next load_pages() resumes it.
+        template <typename Fetch_page>
+        bool load_pages(Fetch_page fetch_page, size_t page_size = 256) {
+            if (loaded) return true;
+            if (!fetching()) {
+                if (!stream) stream = std::make_shared<Page_stream>();
+                stream->stop = false;
+                streaming = std::async(std::launch::async, [stream = stream, fetch_page, page_size]() {
+                    Cache_db db;
+                    auto cursor = stream->cursor;
+                    for (auto done = false; !done && !stream->stop;) {
+                        auto page = fetch_page(db, cursor, page_size);
+                        done = page.size() < page_size;
+                        auto lock = std::unique_lock{stream->mutex};
+                        std::move(page.begin(), page.end(), std::back_inserter(stream->arrived));
+                        stream->cursor = cursor;
+                        stream->done = done;
+                    }
+                });
+            }
+            if (stream) {
+                auto lock = std::unique_lock{stream->mutex};
+                std::move(stream->arrived.begin(), stream->arrived.end(), std::back_inserter(nodes));
+                stream->arrived.clear();
+                loaded = stream->done;
+            }
+            if (streaming.valid() && streaming.wait_for(std::chrono::milliseconds(0)) == std::future_status::ready)
+                streaming.get();
+            return loaded;
+        }
+
+        void stop() { if (stream) stream->stop = true; }
+
+    private:
+
+        struct Page_stream {
+            std::mutex          mutex;
+            std::vector<Node>   arrived;    // not moved into nodes yet
+            std::string         cursor;     // after the last page fetched
+            bool                done = false;
+            std::atomic<bool>   stop = false;
+        };
+
+        std::shared_ptr<Page_stream> stream;    // (shared with the fetching thread)
+        std::future<void> streaming;
+    };
+
+    struct Package_node {
+        int64_t pkg_id = 0;
+        std::string version;
+        std::optional<Package_info> pkg_info; // TODO: rename ?
+        std::optional<std::chrono::steady_clock::time_point> info_time; // when pkg_info was obtained (if known)
+        std::future<std::optional<Package_info>> get_info_fut;  // the promise is shared with the inspect job, so nodes can move; empty if the inspect failed
+        bool info_failed = false;   // not re-queried automatically then
+        // async_data<Package_info> pkg_info;
+    };
 
-        bool fetching() const { return fetch.valid(); }
-        bool fetching_done() const { return fetch.wait_for(std::chrono::milliseconds(0)) == std::future_status::ready; }
+    struct Channel_node {
+        Tree_aggregate summary;
+        Lazy_children<Package_node> packages;
     };
 
-    struct Reference_node {
-        std::vector<std::pair<std::string, Remote_node>> remotes;
-        Reference_node(Reference_node&&) = default;
-        Reference_node& operator = (Reference_node&&) = default;
-        Reference_node() = default;
+    struct User_node {
+        Tree_aggregate summary;
+        Lazy_children<Channel_node> channels;
     };
 
     struct Remote_node {
-        std::vector<std::pair<std::string, User_node>> users;
-        Remote_node(Remote_node&&) = default;
-        Remote_node& operator = (Remote_node&&) = default;
-        Remote_node() = default;
+        Tree_aggregate summary;
+        Lazy_children<User_node> users;
     };
 
-    struct User_node {
-        std::vector<std::pair<std::string, Channel_node>> channels;
-        User_node(User_node&&) = default;
-        User_node& operator = (User_node&&) = default;
-        User_node() = default;
+    struct Reference_node {
+        Tree_aggregate summary;
+        Lazy_children<Remote_node> remotes;
     };
 
-    struct Channel_node {
-        std::vector<Package_node> packages;
-        Channel_node(Channel_node&&) = default;
-        Channel_node& operator = (Channel_node&&) = default;
-        Channel_node() = default;
+    // What a re-scan of a letter changed, along with the up-to-date aggregates of all the nodes on the paths
+    // of the changes, so that the loaded part of the tree can be patched in place (instead of reloaded).
+    struct Letter_changes {
+        using Remote_path  = std::pair<std::string, std::string>;                           // name, remote
+        using User_path    = std::tuple<std::string, std::string, std::string>;             // + user
+        using Channel_path = std::tuple<std::string, std::string, std::string, std::string>; // + channel
+
+        int64_t added = 0;
+        int64_t refreshed = 0;
+        int64_t removed = 0;
+        int64_t resumed = 0;        // searches completed by an earlier, interrupted scan
+        std::map<std::string, std::string> failures;    // remotes that could not be read completely
+
+        std::map<std::string, std::optional<Tree_aggregate>> references;   // empty if the reference is gone
+        std::map<std::string, std::vector<Tree_aggregate>>  remotes;    // all remotes of each changed reference
+        std::map<Remote_path, std::vector<Tree_aggregate>>  users;
+        std::map<User_path, std::vector<Tree_aggregate>>    channels;
+        std::map<Channel_path, std::vector<Package_node>>   packages;   // new versions only
+        std::map<Channel_path, std::vector<int64_t>>        removed_packages;
     };
 
-    struct Package_node {
-        int64_t pkg_id = 0;
-        std::string version;
-        std::optional<Package_info> pkg_info; // TODO: rename ?
-        std::promise<Package_info> get_info_prom;
-        std::future<Package_info> get_info_fut;
-        // async_data<Package_info> pkg_info;
+    struct Letter_scan {
+        Scan_marker marker;
+        Conan::Letter_scan_result result;
+        std::string error;          // if the scan could not run at all
+    };
 
-        Package_node(Package_node&& src) noexcept :
-            pkg_id{std::move(src.pkg_id)},
-            version{std::move(src.version)},
-            pkg_info{std::move(src.pkg_info)},
-            get_info_fut{std::move(src.get_info_fut)}
-        {}
-        Package_node& operator = (Package_node&&) noexcept = default;
-        Package_node() = default;
+    struct Letter_node {
+        Tree_aggregate summary;     // label is empty until the letter aggregates have been obtained
+        Lazy_children<Reference_node> references;
+        std::future<Letter_scan> scan;      // Repo Reader
+        std::future<Letter_changes> changes;
+        std::string last_scan;      // outcome of the last re-scan
+        std::string last_scan_failures;     // details (tooltip)
+
+        bool scanning() const { return scan.valid() || changes.valid(); }
     };
 
-    explicit Alphabetic_tree(Conan::Repository_reader&);
+    explicit Alphabetic_tree(Conan::Repository_reader&, Info_freshness = {});
+    ~Alphabetic_tree();
 
     void get_from_database();
 
@@ -94,20 +188,48 @@ private:
         bool done() const { return future.wait_for(std::chrono::milliseconds(0)) == std::future_status::ready; }
     };
 
-    void add_row_to_references_list(References_list& pkg_list, const SQLite::Row& row, const SQLite::Row& prev_row);
+    struct Info_request {
+        Package_key key;
+        int64_t     pkg_id;
+        std::shared_ptr<std::promise<std::optional<Package_info>>> promise;
+    };
+
+    static constexpr size_t info_batch_size = 8;
+
+    static auto package_node_from_row(const Package_row& row) -> Package_node;
 
+    // Queues the inspection of the packages, in batches (the info of a batch is stored in one transaction).
+    // Refreshes and forced re-queries bypass the response cache.
+    void queue_info_requests(std::vector<Info_request>&, Job_queue::Priority, bool bypass_cache = false);
+
+    void fetch_letter_aggregates();
+    void fetch_topic_facets();
+
+    static auto get_letter_changes(char letter, const Letter_scan&) -> Letter_changes;
+    static void apply_letter_changes(Letter_node&, Letter_changes&);
+
+    void draw_topic_facets();
+    void draw_topic_references();     // (instead of the letters, while a topic is selected)
     void draw_letter_node(char letter, Letter_node& node);
-    void draw_reference(const char* pkg_name, Reference_node& node);
-    void draw_remote(const char* version, Remote_node& node);
-    void draw_user(const char* version, User_node& node);
-    void draw_channel(const char* version, Channel_node& node);
+    void draw_reference(Reference_node& node);
+    void draw_remote(Remote_node& node);
+    void draw_user(User_node& node);
+    void draw_channel(Channel_node& node);
     void draw_package(Package_node& node);
 
     Conan::Repository_reader&   repo_reader;
+    Info_freshness              freshness;
+    std::vector<Info_request>   missing_info, stale_info;   // collected while drawing
     Cache_db                    database;
     sqlite3_stmt*               info_query = nullptr; // ditto
 
     std::map<char, Letter_node> root;
+    std::future<std::map<char, Tree_aggregate>> letter_aggregates;
+
+    std::vector<Topic_facet>    facets;
+    std::future<std::vector<Topic_facet>> topic_facets;
+    std::string                 topic_filter;       // selected topic (empty: none)
+    Lazy_children<Reference_node> topic_references; // the references that have it
 
     std::string                 remote, package, user, channel, version;
     // uint64_t                    pkg_id = {};
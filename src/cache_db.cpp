@@ -1,18 +1,60 @@
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <array>
 #include <filesystem>
 #include <string>
 #include <regex>
 #include <format>
+#ifndef WIN32
+#include <unistd.h>
+#include <pwd.h>
+#endif
+#include "./string_utils.h"
+#include "./compression.h"
 #include "./cache_db.h"
 
 
+// Bounds of the names starting with a letter, in either case: [U, U+1) and [l, l+1) - range conditions
+// (instead of LIKE) so that the indexes on name can be used
+static auto letter_bounds(char letter) -> std::array<std::string, 4>
+{
+    auto upper = static_cast<char>(toupper(letter)), lower = static_cast<char>(tolower(letter));
+    return { std::string(1, upper), std::string(1, upper + 1), std::string(1, lower), std::string(1, lower + 1) };
+}
+
+// Placeholders of a list parameter: "?first, ?first+1, ..." (count of them)
+static auto list_placeholders(size_t first, size_t count) -> std::string
+{
+    std::string placeholders;
+    for (auto i = first; i < first + count; i++)
+        placeholders += std::format("{0}?{1}", placeholders.empty() ? "" : ", ", i);
+    return placeholders;
+}
+
+static auto package_entry_from_row(const SQLite::Row_view& row) -> Package_list_entry
+{
+    Package_list_entry entry;
+    entry.id                = row.int64(0);
+    entry.reference.package = row.text(1);
+    entry.remote            = row.text(2);
+    entry.reference.user    = row.text(3);
+    entry.reference.channel = row.text(4);
+    entry.reference.version = row.text(5);
+    return entry;
+}
+
 static auto get_filename() {
+    // Allows benchmarks and scale tests to work on a separate (e.g. synthetic) cache
+    if (auto filename = getenv("CONAN_GUI_CACHE_DB")) return std::string{ filename };
+
 #ifdef WIN32
     std::filesystem::path appdata_dir = getenv("LOCALAPPDATA");
     auto db_dir = appdata_dir / "ConanDB";
 #else
     // TODO: TEST!
-    appdata_dir = getenv("HOME");
+    auto home = getenv("HOME");
+    std::filesystem::path appdata_dir = home ? home : "";
     if (appdata_dir.empty()) {
         auto passwd = getpwuid(getuid());
         if (!passwd) throw std::runtime_error("Impossible to determine user home directory");
@@ -24,6 +66,371 @@ static auto get_filename() {
     return filename.string();
 }
 
+// The schema, as the migrations from each version to the next: create_or_update() applies the ones above the
+// database's user_version, in order, each in its own transaction. They must be quick (a few seconds for the
+// largest caches): what takes longer is left to a backfill (see below).
+struct Schema_migration {
+    int64_t             version;        // user_version once applied
+    std::string_view    description;
+    std::string_view    script;
+};
+
+static const Schema_migration schema_migrations[] = {
+
+    { 15, "create packages2 table", R"(
+
+        CREATE TABLE IF NOT EXISTS packages2 (
+            id INTEGER PRIMARY KEY AUTOINCREMENT,
+            remote STRING NOT NULL,
+            name STRING NOT NULL,
+            version STRING NOT NULL,
+            user STRING,
+            channel STRING,
+            last_poll DATETIME
+        );
+        CREATE UNIQUE INDEX IF NOT EXISTS packages2_unique ON packages2(remote, name, version, user, channel);
+
+        CREATE TABLE IF NOT EXISTS pkg_info (
+            pkg_id INTEGER,
+            recipe_id,
+            remote STRING,
+            url STRING,
+            license STRING,
+            description STRING,
+            provides STRING,
+            author STRING,
+            topics STRING,
+            creation_date DATETIME,
+            last_poll DATETIME,
+            FOREIGN KEY (pkg_id) REFERENCES packages2(id)
+        );
+        CREATE UNIQUE INDEX IF NOT EXISTS pkg_info_pkg_id ON pkg_info (pkg_id);
+
+        CREATE TABLE IF NOT EXISTS letter_scans (
+            letter CHAR PRIMARY KEY,
+            last_scan DATETIME
+        );
+
+    )" },
+
+    { 16, "create index packages2_tree", R"(
+
+        -- Covering index for the tree aggregates (and the per-level child queries)
+        CREATE INDEX IF NOT EXISTS packages2_tree ON packages2(name, remote, user, channel, version);
+
+    )" },
+
+    { 17, "add scan generations", R"(
+
+        -- Scan generations (see begin_scan() and sweep_packages()); rows predating them have a NULL scan_gen
+        ALTER TABLE packages2 ADD COLUMN scan_gen INTEGER;
+
+        CREATE TABLE IF NOT EXISTS scan_gens (
+            gen INTEGER PRIMARY KEY AUTOINCREMENT,
+            remote STRING NOT NULL,
+            prefix STRING NOT NULL,
+            started DATETIME,
+            swept DATETIME,
+            removed INTEGER
+        );
+
+        -- Purging a package purges its info
+        CREATE TRIGGER IF NOT EXISTS packages2_purge AFTER DELETE ON packages2 BEGIN
+            DELETE FROM pkg_info WHERE pkg_id = OLD.id;
+        END;
+
+    )" },
+
+    { 18, "create prefix_scans table", R"(
+
+        CREATE TABLE IF NOT EXISTS prefix_scans (
+            remote STRING NOT NULL,
+            prefix STRING NOT NULL,
+            results INTEGER,
+            duration_ms INTEGER,
+            last_scan DATETIME,
+            PRIMARY KEY (remote, prefix)
+        );
+
+    )" },
+
+    { 19, "create crawler tables", R"(
+
+        CREATE TABLE IF NOT EXISTS crawl_queue (
+            pkg_id INTEGER PRIMARY KEY,
+            rank INTEGER NOT NULL,          -- 1 = newest version of its reference/remote/user/channel
+            attempts INTEGER NOT NULL DEFAULT 0
+        );
+        CREATE INDEX IF NOT EXISTS crawl_queue_order ON crawl_queue(rank, pkg_id);
+
+        CREATE TABLE IF NOT EXISTS crawler_state (
+            id INTEGER PRIMARY KEY CHECK (id = 1),
+            enabled INTEGER,
+            done INTEGER,
+            failed INTEGER
+        );
+
+    )" },
+
+    { 20, "create responses table", R"(
+
+        CREATE TABLE IF NOT EXISTS responses (
+            remote STRING NOT NULL,
+            command STRING NOT NULL,        -- conan arguments, normalized
+            output BLOB,                    -- zlib-compressed stdout
+            size INTEGER,                   -- uncompressed size of the output
+            stored_at DATETIME,
+            PRIMARY KEY (remote, command)
+        );
+
+    )" },
+
+    { 21, "create scan failure tables", R"(
+
+        -- Why the last attempt at a scan did not complete (NULL once swept)
+        ALTER TABLE scan_gens ADD COLUMN failure STRING;
+
+        -- Searches of the scans that have not been swept yet (see get_resumable_scan())
+        CREATE TABLE IF NOT EXISTS scan_searches (
+            gen INTEGER NOT NULL,
+            pattern STRING NOT NULL,
+            results INTEGER,
+            duration_ms INTEGER,
+            PRIMARY KEY (gen, pattern)
+        );
+
+        CREATE TABLE IF NOT EXISTS remote_failures (
+            remote STRING PRIMARY KEY,
+            kind STRING,
+            message STRING,
+            consecutive INTEGER,
+            last_failure DATETIME,
+            last_success DATETIME
+        );
+
+    )" },
+
+    { 22, "create remotes table", R"(
+
+        -- The remotes conan knows of, as last read (so that they are available at startup without running
+        -- conan); priority is their position in conan's list
+        CREATE TABLE IF NOT EXISTS remotes (
+            name STRING PRIMARY KEY,
+            url STRING NOT NULL,
+            verify_ssl INTEGER NOT NULL DEFAULT 1,
+            enabled INTEGER NOT NULL DEFAULT 1,
+            priority INTEGER NOT NULL DEFAULT 0,
+            last_health_check DATETIME,
+            healthy INTEGER NOT NULL DEFAULT 1,
+            updated DATETIME
+        );
+
+    )" },
+
+    // The remotes, names, users and channels of the packages are interned in dictionary tables, so that
+    // packages3 and its indexes hold integers (and the version) instead of repeating the strings. The packages
+    // keep their id, and with it their pkg_info (rebuilt with its foreign key on packages3: one on the packages2
+    // view would be a "foreign key mismatch" with foreign keys enabled).
+    { 23, "intern the package keys", R"(
+
+        CREATE TABLE dict_remotes (id INTEGER PRIMARY KEY, value STRING NOT NULL UNIQUE);
+        CREATE TABLE dict_names (id INTEGER PRIMARY KEY, value STRING NOT NULL UNIQUE);
+        CREATE TABLE dict_users (id INTEGER PRIMARY KEY, value STRING NOT NULL UNIQUE);
+        CREATE TABLE dict_channels (id INTEGER PRIMARY KEY, value STRING NOT NULL UNIQUE);
+
+        INSERT INTO dict_remotes (value) SELECT DISTINCT remote FROM packages2;
+        INSERT INTO dict_names (value) SELECT DISTINCT name FROM packages2;
+        INSERT INTO dict_users (value) SELECT DISTINCT IFNULL(user, '') FROM packages2;
+        INSERT INTO dict_channels (value) SELECT DISTINCT IFNULL(channel, '') FROM packages2;
+
+        CREATE TABLE packages3 (
+            id INTEGER PRIMARY KEY AUTOINCREMENT,
+            remote_id INTEGER NOT NULL,
+            name_id INTEGER NOT NULL,
+            user_id INTEGER NOT NULL,
+            channel_id INTEGER NOT NULL,
+            version STRING NOT NULL,
+            last_poll DATETIME,
+            scan_gen INTEGER
+        );
+        INSERT INTO packages3 (id, remote_id, name_id, user_id, channel_id, version, last_poll, scan_gen)
+            SELECT packages2.id, dict_remotes.id, dict_names.id, dict_users.id, dict_channels.id, version, last_poll, scan_gen
+            FROM packages2
+            JOIN dict_remotes ON dict_remotes.value = packages2.remote
+            JOIN dict_names ON dict_names.value = packages2.name
+            JOIN dict_users ON dict_users.value = IFNULL(packages2.user, '')
+            JOIN dict_channels ON dict_channels.value = IFNULL(packages2.channel, '');
+
+        -- (Ids are not reused: the sequence carries on from that of packages2)
+        DELETE FROM sqlite_sequence WHERE name = 'packages3';
+        UPDATE sqlite_sequence SET name = 'packages3' WHERE name = 'packages2';
+
+        CREATE UNIQUE INDEX packages3_unique ON packages3(remote_id, name_id, user_id, channel_id, version);
+        -- Covering index for the tree aggregates (by name id: the names are ordered by the index of dict_names)
+        CREATE INDEX packages3_tree ON packages3(name_id, remote_id, user_id, channel_id, version);
+
+        DROP TABLE packages2;
+
+        CREATE TABLE pkg_info3 (
+            pkg_id INTEGER,
+            recipe_id,
+            remote STRING,
+            url STRING,
+            license STRING,
+            description STRING,
+            provides STRING,
+            author STRING,
+            topics STRING,
+            creation_date DATETIME,
+            last_poll DATETIME,
+            FOREIGN KEY (pkg_id) REFERENCES packages3(id)
+        );
+        INSERT INTO pkg_info3 (pkg_id, recipe_id, remote, url, license, description, provides, author, topics, creation_date, last_poll)
+            SELECT pkg_id, recipe_id, remote, url, license, description, provides, author, topics, creation_date, last_poll
+            FROM pkg_info;
+        DROP TABLE pkg_info;
+        ALTER TABLE pkg_info3 RENAME TO pkg_info;
+        CREATE UNIQUE INDEX pkg_info_pkg_id ON pkg_info (pkg_id);
+
+        CREATE TRIGGER packages3_purge AFTER DELETE ON packages3 BEGIN
+            DELETE FROM pkg_info WHERE pkg_id = OLD.id;
+        END;
+
+        -- For ad-hoc queries: packages3 with the strings, under the name and with the columns of the old table
+        CREATE VIEW packages2 AS
+            SELECT packages3.id, dict_remotes.value AS remote, dict_names.value AS name, version,
+                dict_users.value AS user, dict_channels.value AS channel, last_poll, scan_gen
+            FROM packages3
+            JOIN dict_remotes ON dict_remotes.id = packages3.remote_id
+            JOIN dict_names ON dict_names.id = packages3.name_id
+            JOIN dict_users ON dict_users.id = packages3.user_id
+            JOIN dict_channels ON dict_channels.id = packages3.channel_id;
+
+    )" },
+
+    // Sort keys of the versions, so that the tree queries need not run SEMVER_KEY() (a regex) on every row
+    // they go through; the existing rows get theirs from the "sort keys" backfill
+    { 24, "add version sort keys", R"(
+
+        ALTER TABLE packages3 ADD COLUMN semver_key INTEGER;
+
+        -- Progress of the backfills (last_id: the last row done)
+        CREATE TABLE IF NOT EXISTS backfills (
+            name STRING PRIMARY KEY,
+            last_id INTEGER NOT NULL DEFAULT 0,
+            rows_done INTEGER NOT NULL DEFAULT 0,
+            rows_total INTEGER NOT NULL DEFAULT 0,
+            finished DATETIME
+        );
+        INSERT INTO backfills (name, rows_total) SELECT 'sort keys', COUNT(*) FROM packages3;
+
+    )" },
+
+    // The topics of the packages, interned, with an index by topic, so that the packages that have a topic can
+    // be found (and counted) without going through pkg_info; the comma-separated lists of pkg_info.topics are
+    // moved by the "topics" backfill
+    { 25, "normalize the topics", R"(
+
+        CREATE TABLE dict_topics (id INTEGER PRIMARY KEY, value STRING NOT NULL UNIQUE);
+
+        CREATE TABLE pkg_topics (
+            pkg_id INTEGER NOT NULL,
+            topic_id INTEGER NOT NULL,
+            PRIMARY KEY (pkg_id, topic_id)
+        ) WITHOUT ROWID;
+        -- The inverted index (covering: the facet counts and the filters need nothing else from pkg_topics)
+        CREATE INDEX pkg_topics_topic ON pkg_topics(topic_id, pkg_id);
+
+        DROP TRIGGER packages3_purge;
+        CREATE TRIGGER packages3_purge AFTER DELETE ON packages3 BEGIN
+            DELETE FROM pkg_info WHERE pkg_id = OLD.id;
+            DELETE FROM pkg_topics WHERE pkg_id = OLD.id;
+        END;
+
+        INSERT INTO backfills (name, rows_total) SELECT 'topics', COUNT(*) FROM pkg_info WHERE topics <> '';
+
+    )" },
+
+    // All the other attributes "conan inspect" prints (url, homepage, settings, options...), as key/value pairs
+    // with interned keys, so that new ones can be shown without a schema change (the packages get theirs as
+    // their info is refreshed)
+    { 26, "add the package attributes", R"(
+
+        CREATE TABLE dict_attr_keys (id INTEGER PRIMARY KEY, value STRING NOT NULL UNIQUE);
+
+        CREATE TABLE pkg_attrs (
+            pkg_id INTEGER NOT NULL,
+            key_id INTEGER NOT NULL,
+            value STRING NOT NULL,
+            PRIMARY KEY (pkg_id, key_id)
+        ) WITHOUT ROWID;
+
+        DROP TRIGGER packages3_purge;
+        CREATE TRIGGER packages3_purge AFTER DELETE ON packages3 BEGIN
+            DELETE FROM pkg_info WHERE pkg_id = OLD.id;
+            DELETE FROM pkg_topics WHERE pkg_id = OLD.id;
+            DELETE FROM pkg_attrs WHERE pkg_id = OLD.id;
+        END;
+
+    )" },
+};
+
+// Backfills: the part of a migration that goes through all the rows of a table, run in the background (see
+// Cache_writer) a chunk at a time, in between the other writes, and resumed where it stopped by the next
+// session. "rows" selects the ids of the next chunk (up to ?2 ids above ?1, in order), then the statements of
+// "chunk" process the rows with ids in (?1, ?2]; once there are none left, "finish" runs (in the same transaction
+// as the last chunk). Until then the queries do without what is being backfilled, as they did before the
+// migration (see Cache_db::Cache_db()).
+struct Schema_backfill {
+    std::string_view                name;
+    std::string_view                rows;
+    std::vector<std::string_view>   chunk;
+    std::string_view                finish;
+};
+
+static const Schema_backfill schema_backfills[] = {
+
+    { "sort keys", R"(
+
+        SELECT id FROM packages3 WHERE id > ?1 ORDER BY id LIMIT ?2
+
+    )", {
+        "UPDATE packages3 SET semver_key = SEMVER_KEY(version) WHERE id > ?1 AND id <= ?2",
+    }, R"(
+
+        -- With the sort key before the version, the versions of a channel come in order from the index
+        DROP INDEX IF EXISTS packages3_tree;
+        CREATE INDEX packages3_tree ON packages3(name_id, remote_id, user_id, channel_id, semver_key, version);
+
+    )" },
+
+    // (The lists are cleared once moved, so that a package whose info gets stored anew is left alone)
+    { "topics", R"(
+
+        SELECT pkg_id FROM pkg_info WHERE pkg_id > ?1 AND topics <> '' ORDER BY pkg_id LIMIT ?2
+
+    )", {
+        R"(
+        WITH RECURSIVE split (pkg_id, topic, rest) AS (
+            SELECT pkg_id, '', topics || ',' FROM pkg_info WHERE pkg_id > ?1 AND pkg_id <= ?2 AND topics <> ''
+            UNION ALL
+            SELECT pkg_id, TRIM(SUBSTR(rest, 1, INSTR(rest, ',') - 1)), SUBSTR(rest, INSTR(rest, ',') + 1) FROM split WHERE rest <> ''
+        )
+        INSERT OR IGNORE INTO dict_topics (value) SELECT DISTINCT topic FROM split WHERE topic <> ''
+        )",
+        R"(
+        WITH RECURSIVE split (pkg_id, topic, rest) AS (
+            SELECT pkg_id, '', topics || ',' FROM pkg_info WHERE pkg_id > ?1 AND pkg_id <= ?2 AND topics <> ''
+            UNION ALL
+            SELECT pkg_id, TRIM(SUBSTR(rest, 1, INSTR(rest, ',') - 1)), SUBSTR(rest, INSTR(rest, ',') + 1) FROM split WHERE rest <> ''
+        )
+        INSERT OR IGNORE INTO pkg_topics (pkg_id, topic_id)
+        SELECT split.pkg_id, dict_topics.id FROM split JOIN dict_topics ON dict_topics.value = split.topic
+        )",
+        "UPDATE pkg_info SET topics = NULL WHERE pkg_id > ?1 AND pkg_id <= ?2 AND topics IS NOT NULL",
+    }, "" },
+};
+
 
 Cache_db::Cache_db():
     Database{ get_filename().c_str() }
@@ -55,133 +462,658 @@ Cache_db::Cache_db():
         nullptr, nullptr
     );
 
+    // Single sortable key for a semantic version: the (up to) 4 parts, 16 bits each
+    sqlite3_create_function(
+        handle(),
+        "SEMVER_KEY", 1,
+        SQLITE_UTF8 | SQLITE_DETERMINISTIC | SQLITE_DIRECTONLY,
+        nullptr,
+        [](sqlite3_context* context, int argc, sqlite3_value** argv) {
+            auto text = (const char*)sqlite3_value_text(argv[0]);
+            if (auto key = text ? semver_key(text) : std::nullopt)
+                sqlite3_result_int64(context, *key);
+            else
+                sqlite3_result_null(context);
+        },
+        nullptr, nullptr
+    );
+
     create_or_update();
 
-    get_list_stmt = prepare_statement(R"(
-        SELECT id, name, packages2.remote, user, channel, version, description, license, provides, author, topics 
-        FROM packages2
-        LEFT OUTER JOIN pkg_info ON pkg_info.pkg_id = packages2.id
-        WHERE name LIKE ?1
-        ORDER BY SUBSTR(name, 1, 1) COLLATE NOCASE ASC, name ASC, packages2.remote ASC, user ASC, channel ASC,
+    // (The sort keys of the versions are only used once they have all been backfilled)
+    version_key = backfill_finished("sort keys") ? "semver_key" : "SEMVER_KEY(version)";
+    topics_moved = backfill_finished("topics");
+
+    for (auto i = 0U; i < dictionary_tables.size(); i++) {
+        find_value_stmts[i] = { *this, std::format("SELECT id FROM {0} WHERE value = ?1", dictionary_tables[i]) };
+        insert_value_stmts[i] = { *this, std::format("INSERT INTO {0} (value) VALUES(?1) RETURNING id", dictionary_tables[i]) };
+    }
+
+    // The strings of the package keys are looked up in the dictionaries (by value for the conditions, by id for
+    // the columns); everything else happens on the integer ids of packages3
+
+    get_list_stmt = { *this, R"(
+        SELECT packages3.id, dict_names.value, dict_remotes.value, dict_users.value, dict_channels.value, version,
+            description, license, provides, author,
+            CAST(strftime('%s', 'now') - strftime('%s', pkg_info.last_poll) AS INTEGER) AS info_age
+        FROM packages3
+        JOIN dict_names ON dict_names.id = packages3.name_id
+        JOIN dict_remotes ON dict_remotes.id = packages3.remote_id
+        JOIN dict_users ON dict_users.id = packages3.user_id
+        JOIN dict_channels ON dict_channels.id = packages3.channel_id
+        LEFT OUTER JOIN pkg_info ON pkg_info.pkg_id = packages3.id
+        WHERE dict_names.value LIKE ?1
+        ORDER BY SUBSTR(dict_names.value, 1, 1) COLLATE NOCASE ASC, dict_names.value ASC, dict_remotes.value ASC,
+            dict_users.value ASC, dict_channels.value ASC,
             SEMVER_PART(version, 1) DESC, SEMVER_PART(version, 2) DESC, SEMVER_PART(version, 3) DESC, SEMVER_PART(version, 4) DESC
-    )");
+    )" };
+
+    get_versions_stmt = { *this, std::format(R"(
+        SELECT packages3.id, dict_names.value, dict_remotes.value, dict_users.value, dict_channels.value, version,
+            description, license, provides, author,
+            CAST(strftime('%s', 'now') - strftime('%s', pkg_info.last_poll) AS INTEGER) AS info_age
+        FROM packages3
+        JOIN dict_names ON dict_names.id = packages3.name_id
+        JOIN dict_remotes ON dict_remotes.id = packages3.remote_id
+        JOIN dict_users ON dict_users.id = packages3.user_id
+        JOIN dict_channels ON dict_channels.id = packages3.channel_id
+        LEFT OUTER JOIN pkg_info ON pkg_info.pkg_id = packages3.id
+        WHERE dict_names.value = ?1 AND dict_remotes.value = ?2 AND dict_users.value = ?3 AND dict_channels.value = ?4
+        ORDER BY {0} DESC, version DESC
+    )", version_key) };
+
+    // The aggregate queries rely on SQLite's "bare column" rule: with a single MAX(), the bare column
+    // "version" is taken from the row that has the maximum.
 
-    get_pkg_info = prepare_statement(R"(
-        SELECT description, license, provides, author, topics, creation_date, last_poll
+    // (One range of names at a time: with an OR of the two, SQLite would rather scan all the names in order)
+    reference_aggregates_stmt = { *this, std::format(R"(
+        SELECT dict_names.value, COUNT(DISTINCT remote_id), COUNT(*), version, MAX({0})
+        FROM dict_names
+        JOIN packages3 ON packages3.name_id = dict_names.id
+        WHERE dict_names.value >= ?1 AND dict_names.value < ?2
+        GROUP BY dict_names.value
+        ORDER BY dict_names.value
+    )", version_key) };
+
+    get_reference_page_stmt = { *this, std::format(R"(
+        SELECT dict_names.value, COUNT(DISTINCT remote_id), COUNT(*), version, MAX({0})
+        FROM dict_names
+        JOIN packages3 ON packages3.name_id = dict_names.id
+        WHERE dict_names.value >= ?1 AND dict_names.value < ?2 AND dict_names.value > ?3
+        GROUP BY dict_names.value
+        ORDER BY dict_names.value
+        LIMIT ?4
+    )", version_key) };
+
+    reference_aggregate_stmt = { *this, std::format(R"(
+        SELECT dict_names.value, COUNT(DISTINCT remote_id), COUNT(*), version, MAX({0})
+        FROM dict_names
+        JOIN packages3 ON packages3.name_id = dict_names.id
+        WHERE dict_names.value = ?1
+        GROUP BY dict_names.value
+    )", version_key) };
+
+    remote_aggregates_stmt = { *this, std::format(R"(
+        SELECT dict_remotes.value, COUNT(DISTINCT user_id), COUNT(*), version, MAX({0})
+        FROM dict_names
+        JOIN packages3 ON packages3.name_id = dict_names.id
+        JOIN dict_remotes ON dict_remotes.id = packages3.remote_id
+        WHERE dict_names.value = ?1
+        GROUP BY dict_remotes.value
+        ORDER BY dict_remotes.value
+    )", version_key) };
+
+    user_aggregates_stmt = { *this, std::format(R"(
+        SELECT dict_users.value, COUNT(DISTINCT channel_id), COUNT(*), version, MAX({0})
+        FROM dict_names
+        JOIN dict_remotes
+        JOIN packages3 ON packages3.name_id = dict_names.id AND packages3.remote_id = dict_remotes.id
+        JOIN dict_users ON dict_users.id = packages3.user_id
+        WHERE dict_names.value = ?1 AND dict_remotes.value = ?2
+        GROUP BY dict_users.value
+        ORDER BY dict_users.value
+    )", version_key) };
+
+    channel_aggregates_stmt = { *this, std::format(R"(
+        SELECT dict_channels.value, COUNT(*), COUNT(*), version, MAX({0})
+        FROM dict_names
+        JOIN dict_remotes
+        JOIN dict_users
+        JOIN packages3 ON packages3.name_id = dict_names.id AND packages3.remote_id = dict_remotes.id AND packages3.user_id = dict_users.id
+        JOIN dict_channels ON dict_channels.id = packages3.channel_id
+        WHERE dict_names.value = ?1 AND dict_remotes.value = ?2 AND dict_users.value = ?3
+        GROUP BY dict_channels.value
+        ORDER BY dict_channels.value
+    )", version_key) };
+
+    get_pkg_info = { *this, R"(
+        SELECT description, license, provides, author, creation_date, last_poll
         FROM pkg_info
         WHERE pkg_id=?1;
-    )");
+    )" };
 
-    upsert_pkg_info = prepare_upsert(
-        "pkg_info", 
-        { "pkg_id"}, 
-        { "description", "license", "provides", "author", "topics", "creation_date", "last_poll" }
-    );
+    // (The topics go to pkg_topics; what is left of the lists of pkg_info.topics is moved by the "topics" backfill)
+    upsert_pkg_info = { *this, R"(
+        INSERT INTO pkg_info (pkg_id, description, license, provides, author, topics, creation_date, last_poll)
+            VALUES(?1, ?2, ?3, ?4, ?5, NULL, ?6, datetime('now'))
+        ON CONFLICT(pkg_id) DO UPDATE SET description=?2, license=?3, provides=?4, author=?5, topics=NULL,
+            creation_date=?6, last_poll=datetime('now')
+    )" };
+
+    delete_pkg_topics = { *this, R"(
+        DELETE FROM pkg_topics WHERE pkg_id = ?1
+    )" };
+
+    insert_pkg_topic = { *this, R"(
+        INSERT OR IGNORE INTO pkg_topics (pkg_id, topic_id) VALUES(?1, ?2)
+    )" };
+
+    // (The package ids are bound id_list_size at a time, see for_each_id_chunk())
+    get_topics_stmt = { *this, std::format(R"(
+        SELECT pkg_id, dict_topics.value
+        FROM pkg_topics
+        JOIN dict_topics ON dict_topics.id = pkg_topics.topic_id
+        WHERE pkg_id IN ({0})
+        ORDER BY pkg_id, dict_topics.value
+    )", list_placeholders(1, id_list_size)), SQLite::Deferred_statement::Shape{ id_list_size, 2 } };
+
+    get_topic_lists_stmt = { *this, std::format(R"(
+        SELECT pkg_id, topics FROM pkg_info WHERE pkg_id IN ({0}) AND topics <> ''
+    )", list_placeholders(1, id_list_size)), SQLite::Deferred_statement::Shape{ id_list_size, 2 } };
+
+    delete_pkg_attrs = { *this, R"(
+        DELETE FROM pkg_attrs WHERE pkg_id = ?1
+    )" };
+
+    insert_pkg_attr = { *this, R"(
+        INSERT OR REPLACE INTO pkg_attrs (pkg_id, key_id, value) VALUES(?1, ?2, ?3)
+    )" };
+
+    // (Bound like the topics; the ids of the keys follow the package ids, key_list_size of them)
+    get_all_attributes_stmt = { *this, std::format(R"(
+        SELECT pkg_id, dict_attr_keys.value, pkg_attrs.value
+        FROM pkg_attrs
+        JOIN dict_attr_keys ON dict_attr_keys.id = pkg_attrs.key_id
+        WHERE pkg_id IN ({0})
+    )", list_placeholders(1, id_list_size)), SQLite::Deferred_statement::Shape{ id_list_size, 3 } };
+
+    get_attributes_stmt = { *this, std::format(R"(
+        SELECT pkg_id, dict_attr_keys.value, pkg_attrs.value
+        FROM pkg_attrs
+        JOIN dict_attr_keys ON dict_attr_keys.id = pkg_attrs.key_id
+        WHERE pkg_id IN ({0}) AND key_id IN ({1})
+    )", list_placeholders(1, id_list_size), list_placeholders(id_list_size + 1, key_list_size)),
+        SQLite::Deferred_statement::Shape{ id_list_size + key_list_size, 3 } };
+
+    upsert_package_stmt = { *this, R"(
+        INSERT INTO packages3 (remote_id, name_id, user_id, channel_id, version, semver_key, last_poll, scan_gen)
+            VALUES(?1, ?2, ?3, ?4, ?5, SEMVER_KEY(?5), datetime('now'), NULLIF(?6, 0))
+        ON CONFLICT (remote_id, name_id, user_id, channel_id, version) DO UPDATE SET last_poll=datetime('now'), scan_gen=IFNULL(NULLIF(?6, 0), scan_gen)
+        RETURNING id
+    )" };
+
+    insert_scan_gen = { *this, R"(
+        INSERT INTO scan_gens (remote, prefix, started) VALUES(?1, ?2, datetime('now'))
+    )" };
+
+    // (A search of packages3_tree for each name of the ranges)
+    sweep_packages_stmt = { *this, R"(
+        DELETE FROM packages3
+        WHERE remote_id = (SELECT id FROM dict_remotes WHERE value = ?1)
+            AND name_id IN (SELECT id FROM dict_names WHERE (value >= ?2 AND value < ?3) OR (value >= ?4 AND value < ?5))
+            AND (scan_gen IS NULL OR scan_gen < ?6)
+        RETURNING id, (SELECT value FROM dict_names WHERE id = name_id), ?1,
+            (SELECT value FROM dict_users WHERE id = user_id), (SELECT value FROM dict_channels WHERE id = channel_id), version
+    )" };
+
+    complete_scan_gen = { *this, R"(
+        UPDATE scan_gens SET swept = datetime('now'), removed = ?2, failure = NULL WHERE gen = ?1
+    )" };
+
+    get_resumable_scan_stmt = { *this, R"(
+        SELECT gen, swept IS NULL AND started >= datetime('now', '-1 day')
+        FROM scan_gens
+        WHERE remote = ?1 AND prefix = ?2
+        ORDER BY gen DESC
+        LIMIT 1
+    )" };
+
+    get_completed_searches_stmt = { *this, R"(
+        SELECT pattern, results, duration_ms FROM scan_searches WHERE gen = ?1
+    )" };
+
+    mark_search_completed_stmt = { *this, R"(
+        INSERT INTO scan_searches (gen, pattern, results, duration_ms) VALUES(?1, ?2, ?3, ?4)
+        ON CONFLICT(gen, pattern) DO UPDATE SET results=?3, duration_ms=?4
+    )" };
+
+    mark_scan_failed_stmt = { *this, R"(
+        UPDATE scan_gens SET failure = ?2 WHERE gen = ?1
+    )" };
+
+    record_remote_failure_stmt = { *this, R"(
+        INSERT INTO remote_failures (remote, kind, message, consecutive, last_failure) VALUES(?1, ?2, ?3, 1, datetime('now'))
+        ON CONFLICT(remote) DO UPDATE SET kind=?2, message=?3, consecutive=consecutive + 1, last_failure=datetime('now')
+    )" };
 
-    upsert_letter_scan_time = prepare_statement(R"(
+    // (No write at all while the remote is healthy)
+    record_remote_success_stmt = { *this, R"(
+        UPDATE remote_failures SET consecutive = 0, last_success = datetime('now') WHERE remote = ?1 AND consecutive > 0
+    )" };
+
+    get_remotes_stmt = { *this, R"(
+        SELECT name, url, verify_ssl, enabled, priority, IFNULL(last_health_check, ''), healthy
+        FROM remotes
+        ORDER BY priority, name
+    )" };
+
+    // (Keeps the health of the remotes that were already known)
+    upsert_remote_stmt = { *this, R"(
+        INSERT INTO remotes (name, url, verify_ssl, enabled, priority, updated) VALUES(?1, ?2, ?3, ?4, ?5, datetime('now'))
+        ON CONFLICT(name) DO UPDATE SET url=?2, verify_ssl=?3, enabled=?4, priority=?5, updated=datetime('now')
+    )" };
+
+    delete_remote_stmt = { *this, R"(
+        DELETE FROM remotes WHERE name = ?1
+    )" };
+
+    record_remote_health_stmt = { *this, R"(
+        UPDATE remotes SET healthy = ?2, last_health_check = datetime('now') WHERE name = ?1
+    )" };
+
+    get_prefix_results_stmt = { *this, R"(
+        SELECT prefix, results FROM prefix_scans WHERE remote = ?1
+    )" };
+
+    upsert_prefix_stats = { *this, R"(
+        INSERT INTO prefix_scans (remote, prefix, results, duration_ms, last_scan) VALUES(?1, ?2, ?3, ?4, datetime('now'))
+        ON CONFLICT(remote, prefix) DO UPDATE SET results=?3, duration_ms=?4, last_scan=datetime('now')
+    )" };
+
+    get_crawl_batch_stmt = { *this, R"(
+        SELECT packages3.id, dict_names.value, dict_remotes.value, dict_users.value, dict_channels.value, version
+        FROM crawl_queue
+        JOIN packages3 ON packages3.id = crawl_queue.pkg_id
+        JOIN dict_names ON dict_names.id = packages3.name_id
+        JOIN dict_remotes ON dict_remotes.id = packages3.remote_id
+        JOIN dict_users ON dict_users.id = packages3.user_id
+        JOIN dict_channels ON dict_channels.id = packages3.channel_id
+        WHERE attempts < ?1 AND NOT EXISTS (SELECT 1 FROM pkg_info WHERE pkg_info.pkg_id = crawl_queue.pkg_id)
+        ORDER BY rank, pkg_id
+        LIMIT ?2
+    )" };
+
+    mark_crawl_failed_stmt = { *this, R"(
+        UPDATE crawl_queue SET attempts = attempts + 1 WHERE pkg_id = ?1
+    )" };
+
+    remove_from_crawl_queue_stmt = { *this, R"(
+        DELETE FROM crawl_queue WHERE pkg_id = ?1
+    )" };
+
+    save_crawler_state_stmt = { *this, R"(
+        INSERT INTO crawler_state (id, enabled, done, failed) VALUES(1, ?1, ?2, ?3)
+        ON CONFLICT(id) DO UPDATE SET enabled=?1, done=?2, failed=?3
+    )" };
+
+    remove_package_stmt = { *this, R"(
+        DELETE FROM packages3
+        WHERE remote_id = (SELECT id FROM dict_remotes WHERE value = ?1) AND name_id = (SELECT id FROM dict_names WHERE value = ?2)
+            AND version = ?3 AND user_id = (SELECT id FROM dict_users WHERE value = ?4)
+            AND channel_id = (SELECT id FROM dict_channels WHERE value = ?5)
+    )" };
+
+    get_response_stmt = { *this, R"(
+        SELECT output, size FROM responses WHERE remote = ?1 AND command = ?2 AND stored_at >= datetime('now', ?3)
+    )" };
+
+    store_response_stmt = { *this, R"(
+        INSERT INTO responses (remote, command, output, size, stored_at) VALUES(?1, ?2, ?3, ?4, datetime('now'))
+        ON CONFLICT(remote, command) DO UPDATE SET output=?3, size=?4, stored_at=datetime('now')
+    )" };
+
+    upsert_letter_scan_time = { *this, R"(
         INSERT INTO letter_scans (letter, last_scan) VALUES(?1, datetime('now')) ON CONFLICT(letter) DO UPDATE SET last_scan=datetime('now'); 
+    )" };
+}
+
+Cache_db::~Cache_db() = default;
+
+void Cache_db::create_or_update()
+{
+    auto version = std::get<int64_t>(select_one("PRAGMA user_version")[0]);
+    auto pending = std::count_if(std::begin(schema_migrations), std::end(schema_migrations), [&](auto& m) { return m.version > version; });
+    if (pending > 0) std::cout << std::format("Cache schema: version {0}, {1} migration(s) to apply", version, pending) << std::endl;
+
+    auto step = 0;
+    for (auto& migration: schema_migrations) {
+        if (migration.version <= version) continue;
+        ++step;
+
+        // (Another connection may have migrated the database in the meantime)
+        auto start = std::chrono::steady_clock::now();
+        auto applied = false;
+        execute("BEGIN IMMEDIATE", "trying to begin a schema migration");
+        try {
+            if (std::get<int64_t>(select_one("PRAGMA user_version")[0]) < migration.version) {
+                std::cout << std::format("Cache schema: {0}/{1}: version {2} ({3})...", step, pending, migration.version, migration.description) << std::endl;
+                execute(migration.script, std::format("trying to migrate the cache to version {0} ({1})", migration.version, migration.description));
+                execute(std::format("PRAGMA user_version = {0}", migration.version), "trying to set the schema version");
+                applied = true;
+            }
+            execute("COMMIT", "trying to commit a schema migration");
+        }
+        catch (...) {
+            execute("ROLLBACK", "trying to roll back a schema migration");
+            throw;
+        }
+        if (applied) {
+            std::cout << std::format("Cache schema: version {0} done in {1} ms", migration.version,
+                std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count()) << std::endl;
+        }
+        version = migration.version;
+    }
+}
+
+auto Cache_db::get_backfills() -> std::vector<Backfill_progress>
+{
+    std::vector<Backfill_progress> backfills;
+    auto stmt = cached_statement(R"(
+        SELECT name, last_id, rows_done, rows_total, finished IS NOT NULL FROM backfills ORDER BY rowid
     )");
+    while (execute(stmt)) {
+        auto row = row_view(stmt);
+        backfills.push_back({ std::string{ row.text(0) }, row.int64(1), row.int64(2), row.int64(3), row.int64(4) != 0 });
+    }
+    return backfills;
 }
 
-Cache_db::~Cache_db()
+bool Cache_db::backfill_finished(std::string_view name)
 {
-    sqlite3_finalize(get_list_stmt);
-    sqlite3_finalize(get_pkg_info);
-    sqlite3_finalize(upsert_pkg_info);
-    sqlite3_finalize(upsert_letter_scan_time);
+    auto row = select_one("SELECT COUNT(*) FROM backfills WHERE name = ?1 AND finished IS NOT NULL", { std::string{name} });
+    return std::get<int64_t>(row[0]) > 0;
 }
 
-void Cache_db::create_or_update()
+auto Cache_db::run_backfill_chunk(size_t rows) -> std::optional<Backfill_progress>
 {
-    auto version = std::get<int64_t>(select_one("PRAGMA user_version")[0]);
-    std::cout << "version: " << version << std::endl;
+    for (auto& progress: get_backfills()) {
+        if (progress.finished) continue;
+        // (Unknown to this version of the application)
+        auto backfill = std::find_if(std::begin(schema_backfills), std::end(schema_backfills), [&](auto& b) { return b.name == progress.name; });
+        if (backfill == std::end(schema_backfills)) continue;
 
-    if (version >= 15) return;
+        auto rows_stmt = cached_statement(backfill->rows);
+        int64_t count = 0, last_id = progress.last_id;
+        while (execute(rows_stmt, { progress.last_id, static_cast<int64_t>(rows) })) {
+            last_id = std::max(last_id, std::get<int64_t>(get_row(rows_stmt)[0]));
+            ++count;
+        }
+        if (count > 0) {
+            for (auto& statement: backfill->chunk) {
+                auto stmt = cached_statement(statement, std::format("trying to run the backfill \"{0}\"", progress.name));
+                while (execute(stmt, { progress.last_id, last_id })) {}
+            }
+        }
+        progress.last_id = last_id;
+        progress.rows_done = std::min(progress.rows_done + count, progress.rows_total);
+        if (count == 0) {
+            if (!backfill->finish.empty())
+                execute(backfill->finish, std::format("trying to finish the backfill \"{0}\"", progress.name));
+            progress.finished = true;
+        }
 
-    execute( R"(
+        execute(cached_statement(R"(
+            UPDATE backfills SET last_id = ?2, rows_done = ?3, finished = CASE WHEN ?4 THEN datetime('now') END WHERE name = ?1
+        )"), { progress.name, progress.last_id, progress.rows_done, int64_t{ progress.finished } });
+        return progress;
+    }
+    return {};
+}
 
-        CREATE TABLE IF NOT EXISTS packages2 (
-            id INTEGER PRIMARY KEY AUTOINCREMENT,
-            remote STRING NOT NULL,
-            name STRING NOT NULL,
-            version STRING NOT NULL,
-            user STRING,
-            channel STRING,
-            last_poll DATETIME
-        );
-        CREATE UNIQUE INDEX IF NOT EXISTS packages2_unique ON packages2(remote, name, version, user, channel);
+void Cache_db::get_list(const std::function<bool(const Package_row&)>& row_cb, std::string_view name_filter)
+{
+    get_list_stmt.for_each([&](const Package_columns& row) { return row_cb(std::make_from_tuple<Package_row>(row)); }, name_filter);
+}
 
-        CREATE TABLE IF NOT EXISTS pkg_info (
-            pkg_id INTEGER,
-            recipe_id,
-            remote STRING,
-            url STRING,
-            license STRING,
-            description STRING,
-            provides STRING,
-            author STRING,
-            topics STRING,
-            creation_date DATETIME,
-            last_poll DATETIME,
-            FOREIGN KEY (pkg_id) REFERENCES packages2(id)
-        );
-        CREATE UNIQUE INDEX IF NOT EXISTS pkg_info_pkg_id ON pkg_info (pkg_id);
+auto Cache_db::get_letter_aggregates() -> std::map<char, Tree_aggregate>
+{
+    std::map<char, Tree_aggregate> aggregates;
 
-        CREATE TABLE IF NOT EXISTS letter_scans (
-            letter CHAR PRIMARY KEY,
-            last_scan DATETIME
-        );
+    // (The versions are counted on packages3_tree alone, before the names are looked up)
+    auto stmt = cached_statement(R"(
+        SELECT UPPER(SUBSTR(value, 1, 1)) AS letter, COUNT(*), SUM(versions)
+        FROM dict_names
+        JOIN (SELECT name_id, COUNT(*) AS versions FROM packages3 GROUP BY name_id) ON name_id = dict_names.id
+        GROUP BY letter
+    )");
+    while (execute(stmt)) {
+        auto row = get_row(stmt);
+        auto& letter = std::get<3>(row[0]);
+        aggregates[letter[0]] = { letter, std::get<1>(row[1]), std::get<1>(row[2]) };
+    }
 
-        PRAGMA user_version = 15;
+    return aggregates;
+}
 
-    )", "trying to create packages2 table");
+auto Cache_db::get_reference_aggregates(char letter) -> std::vector<Tree_aggregate>
+{
+    // (The upper case range comes first, as in the order of the names)
+    auto bounds = letter_bounds(letter);
+    auto aggregates = get_aggregates(reference_aggregates_stmt, { bounds[0], bounds[1] });
+    auto lower_case = get_aggregates(reference_aggregates_stmt, { bounds[2], bounds[3] });
+    aggregates.insert(aggregates.end(), std::make_move_iterator(lower_case.begin()), std::make_move_iterator(lower_case.end()));
+    return aggregates;
 }
 
-void Cache_db::get_list(std::function<bool(SQLite::Row)> row_cb, std::string_view name_filter)
+// The names of a letter are two ranges of dict_names ([U, U+1) and [l, l+1)): the pages go through them one
+// after the other, so that each query is a single range scan (an OR of the two would be sorted as a whole)
+auto Cache_db::get_reference_page(char letter, std::string_view after, size_t page_size) -> std::vector<Tree_aggregate>
 {
-    while (execute(get_list_stmt, { std::string{name_filter} })) {
-        auto row = get_row(get_list_stmt);
-        // std::cout << std::get<3>(row[1]) << std::endl;
-        if (!row_cb(row)) break;
+    std::vector<Tree_aggregate> page;
+
+    auto bounds = letter_bounds(letter);
+    for (auto range = 0; range < 4 && page.size() < page_size; range += 2) {
+        auto &begin = bounds[range], &end = bounds[range + 1];
+        if (after >= end) continue;
+        get_reference_page_stmt.for_each([&](const auto& row) {
+                auto& [name, remotes, versions, latest, semver_key] = row;
+                page.push_back({ name, remotes, versions, latest });
+            },
+            begin, end, after, static_cast<int64_t>(page_size - page.size()));
     }
+    return page;
 }
 
-void Cache_db::upsert_package(std::string_view remote, std::string_view name, std::string_view version, std::string_view user, std::string_view channel)
+auto Cache_db::get_reference_aggregate(std::string_view name) -> std::optional<Tree_aggregate>
 {
-    // TODO: use prepared statement!
+    auto aggregates = get_aggregates(reference_aggregate_stmt, { std::string{name} });
+    if (aggregates.empty()) return {};
+    return aggregates.front();
+}
 
-    auto statement = std::format(R"(
-        INSERT INTO packages2 (remote, name, version, user, channel, last_poll)
-            values('{0}', '{1}', '{2}', '{3}', '{4}', datetime('now'))
-        ON CONFLICT (remote, name, version, user, channel) DO UPDATE SET last_poll=datetime('now');
-    )", remote, name, version, user, channel);
+auto Cache_db::get_remote_aggregates(std::string_view name) -> std::vector<Tree_aggregate>
+{
+    return get_aggregates(remote_aggregates_stmt, { std::string{name} });
+}
 
-    execute(statement.c_str(), "trying to upsert into package2");
+auto Cache_db::get_user_aggregates(std::string_view name, std::string_view remote) -> std::vector<Tree_aggregate>
+{
+    return get_aggregates(user_aggregates_stmt, { std::string{name}, std::string{remote} });
 }
 
+auto Cache_db::get_channel_aggregates(std::string_view name, std::string_view remote, std::string_view user) -> std::vector<Tree_aggregate>
+{
+    return get_aggregates(channel_aggregates_stmt, { std::string{name}, std::string{remote}, std::string{user} });
+}
 
-auto Cache_db::get_package_info(int64_t pkg_id) -> std::optional<Package_info>
+auto Cache_db::get_aggregates(sqlite3_stmt* stmt, std::initializer_list<SQLite::Value> values) -> std::vector<Tree_aggregate>
 {
-    if (execute(get_pkg_info, { pkg_id })) {
-        auto row = get_row(get_pkg_info);
-        return Package_info {
-            .description   = std::get<3>(row[0]),
-            .license       = std::get<3>(row[1]),
-            .provides      = std::get<3>(row[2]),
-            .author        = std::get<3>(row[3]),
-            .topics        = std::get<3>(row[4]),
-            .creation_date = std::get<3>(row[5]),
-        };
+    std::vector<Tree_aggregate> aggregates;
+    while (execute(stmt, values)) {
+        auto row = get_row(stmt);
+        aggregates.push_back({
+            .label    = row[0].index() == 3 ? std::get<3>(row[0]) : "",
+            .children = std::get<1>(row[1]),
+            .versions = std::get<1>(row[2]),
+            .latest   = row[3].index() == 3 ? std::get<3>(row[3]) : "",
+        });
     }
-    return std::optional<Package_info>{};
+    return aggregates;
+}
+
+void Cache_db::get_versions(
+    const std::function<bool(const Package_row&)>& row_cb,
+    std::string_view name, std::string_view remote, std::string_view user, std::string_view channel
+) {
+    get_versions_stmt.for_each([&](const Package_columns& row) { return row_cb(std::make_from_tuple<Package_row>(row)); },
+        name, remote, user, channel);
+}
+
+auto Cache_db::upsert_package(std::string_view remote, std::string_view name, std::string_view version, std::string_view user, std::string_view channel, int64_t scan_gen) -> int64_t
+{
+    auto row = upsert_package_stmt.first(intern(Dictionary::remotes, remote), intern(Dictionary::names, name),
+        intern(Dictionary::users, user), intern(Dictionary::channels, channel), version, scan_gen);
+    return std::get<0>(row.value());
+}
+
+auto Cache_db::intern(Dictionary dictionary, std::string_view value) -> int64_t
+{
+    auto index = static_cast<size_t>(dictionary);
+    if (auto row = find_value_stmts[index].first(value)) return std::get<0>(*row);
+    return std::get<0>(insert_value_stmts[index].first(value).value());
+}
+
+auto Cache_db::get_package_info(int64_t pkg_id) -> std::optional<Package_info>
+{
+    auto row = get_pkg_info.first(pkg_id);
+    if (!row) return {};
+
+    auto& [description, license, provides, author, creation_date, last_poll] = *row;
+    auto topics = get_topics(std::span{ &pkg_id, 1 });
+    auto attributes = get_attributes(std::span{ &pkg_id, 1 });
+    return Package_info {
+        .description   = std::move(description),
+        .license       = std::move(license),
+        .provides      = std::move(provides),
+        .author        = std::move(author),
+        .topics        = topics.empty() ? std::vector<std::string>{} : std::move(topics.begin()->second),
+        .creation_date = std::move(creation_date),
+        .attributes    = attributes.empty() ? std::map<std::string, std::string>{} : std::move(attributes.begin()->second),
+    };
 }
 
 void Cache_db::upsert_package_info(int64_t pkg_id, const Package_info& info)
 {
-    execute(
-        upsert_pkg_info, 
-        { pkg_id, info.description, info.license, info.provides, info.author, join_strings(info.topics) /* TODO */, nullptr /* TODO */ }
-    );
+    upsert_pkg_info.execute(pkg_id, info.description, info.license, info.provides, info.author,
+        info.creation_date.empty() ? std::nullopt : std::optional<std::string_view>{ info.creation_date });
+
+    delete_pkg_topics.execute(pkg_id);
+    for (auto& topic: info.topics)
+        if (!topic.empty()) insert_pkg_topic.execute(pkg_id, intern(Dictionary::topics, topic));
+
+    delete_pkg_attrs.execute(pkg_id);
+    for (auto& [key, value]: info.attributes)
+        insert_pkg_attr.execute(pkg_id, intern(Dictionary::attr_keys, key), value);
+}
+
+void Cache_db::for_each_id_chunk(sqlite3_stmt* stmt, std::span<const int64_t> ids, const std::function<void(const SQLite::Row_view&)>& fn,
+    std::span<const int64_t> key_ids)
+{
+    for (size_t first = 0; first < ids.size(); first += id_list_size) {
+        auto chunk = ids.subspan(first, std::min(id_list_size, ids.size() - first));
+        sqlite3_reset(stmt);
+        // (The lists are padded with their last id, which makes no difference to IN ())
+        for (auto i = 0U; i < id_list_size; i++)
+            check_result(sqlite3_bind_int64(stmt, i + 1, chunk[std::min<size_t>(i, chunk.size() - 1)]), "trying to bind a package id");
+        for (auto i = 0U; i < key_list_size && !key_ids.empty(); i++)
+            check_result(sqlite3_bind_int64(stmt, id_list_size + i + 1, key_ids[std::min<size_t>(i, key_ids.size() - 1)]), "trying to bind a key id");
+        while (step(stmt))
+            fn(row_view(stmt));
+    }
+    sqlite3_reset(stmt);
+}
+
+auto Cache_db::get_topic_facets() -> std::vector<Topic_facet>
+{
+    std::vector<Topic_facet> facets;
+
+    // (Counted on the pkg_topics_topic index alone, before the topics are looked up)
+    auto stmt = cached_statement(R"(
+        SELECT dict_topics.value, packages
+        FROM (SELECT topic_id, COUNT(*) AS packages FROM pkg_topics GROUP BY topic_id)
+        JOIN dict_topics ON dict_topics.id = topic_id
+        ORDER BY packages DESC, dict_topics.value
+    )");
+    while (execute(stmt)) {
+        auto row = row_view(stmt);
+        facets.push_back({ std::string{ row.text(0) }, row.int64(1) });
+    }
+    return facets;
+}
+
+auto Cache_db::get_topic_references(std::string_view topic) -> std::vector<Tree_aggregate>
+{
+    auto stmt = cached_statement(std::format(R"(
+        SELECT dict_names.value, COUNT(DISTINCT remote_id), COUNT(*), version, MAX({0})
+        FROM dict_names
+        JOIN packages3 ON packages3.name_id = dict_names.id
+        WHERE dict_names.id IN (
+            SELECT name_id
+            FROM dict_topics
+            JOIN pkg_topics ON pkg_topics.topic_id = dict_topics.id
+            JOIN packages3 ON packages3.id = pkg_topics.pkg_id
+            WHERE dict_topics.value = ?1
+        )
+        GROUP BY dict_names.value
+        ORDER BY dict_names.value
+    )", version_key));
+    return get_aggregates(stmt, { std::string{topic} });
+}
+
+auto Cache_db::get_topics(std::span<const int64_t> pkg_ids) -> std::map<int64_t, std::vector<std::string>>
+{
+    std::map<int64_t, std::vector<std::string>> topics;
+    if (pkg_ids.empty()) return topics;
+
+    for_each_id_chunk(get_topics_stmt, pkg_ids, [&](const SQLite::Row_view& row) {
+        topics[row.int64(0)].emplace_back(row.text(1));
+    });
+
+    // The lists the backfill has not moved yet
+    if (!topics_moved) {
+        for_each_id_chunk(get_topic_lists_stmt, pkg_ids, [&](const SQLite::Row_view& row) {
+            auto& package_topics = topics[row.int64(0)];
+            for (auto& topic: parseTagList(row.text(1)))
+                package_topics.push_back(std::move(topic));
+            std::sort(package_topics.begin(), package_topics.end());
+        });
+    }
+
+    return topics;
+}
+
+auto Cache_db::get_attributes(std::span<const int64_t> pkg_ids, std::span<const std::string_view> keys)
+    -> std::map<int64_t, std::map<std::string, std::string>>
+{
+    std::map<int64_t, std::map<std::string, std::string>> attributes;
+    if (pkg_ids.empty()) return attributes;
+
+    auto add = [&](const SQLite::Row_view& row) {
+        attributes[row.int64(0)].emplace(row.text(1), row.text(2));
+    };
+    if (keys.empty()) {
+        for_each_id_chunk(get_all_attributes_stmt, pkg_ids, add);
+        return attributes;
+    }
+
+    // (Keys that no package has are not in the dictionary)
+    std::vector<int64_t> key_ids;
+    for (auto key: keys)
+        if (auto row = find_value_stmts[static_cast<size_t>(Dictionary::attr_keys)].first(key)) key_ids.push_back(std::get<0>(*row));
+    for (size_t first = 0; first < key_ids.size(); first += key_list_size)
+        for_each_id_chunk(get_attributes_stmt, pkg_ids, add, std::span{ key_ids }.subspan(first, std::min(key_list_size, key_ids.size() - first)));
+
+    return attributes;
 }
 
 void Cache_db::mark_letter_as_scanned(char letter)
@@ -190,3 +1122,271 @@ void Cache_db::mark_letter_as_scanned(char letter)
         upsert_letter_scan_time, { letter }
     );
 }
+
+auto Cache_db::get_scan_marker() -> Scan_marker
+{
+    auto row = select_one("SELECT IFNULL(MAX(id), 0), datetime('now') FROM packages3");
+    return { std::get<1>(row[0]), std::get<3>(row[1]) };
+}
+
+auto Cache_db::get_added_packages(char letter, const Scan_marker& marker) -> std::vector<Package_list_entry>
+{
+    std::vector<Package_list_entry> packages;
+
+    auto bounds = letter_bounds(letter);
+    auto stmt = cached_statement(R"(
+        SELECT packages3.id, dict_names.value, dict_remotes.value, dict_users.value, dict_channels.value, version
+        FROM packages3
+        JOIN dict_names ON dict_names.id = packages3.name_id
+        JOIN dict_remotes ON dict_remotes.id = packages3.remote_id
+        JOIN dict_users ON dict_users.id = packages3.user_id
+        JOIN dict_channels ON dict_channels.id = packages3.channel_id
+        WHERE packages3.id > ?1
+            AND ((dict_names.value >= ?2 AND dict_names.value < ?3) OR (dict_names.value >= ?4 AND dict_names.value < ?5))
+        ORDER BY dict_names.value, dict_remotes.value, dict_users.value, dict_channels.value
+    )");
+    while (execute(stmt, { marker.max_id, bounds[0], bounds[1], bounds[2], bounds[3] }))
+        packages.push_back(package_entry_from_row(row_view(stmt)));
+
+    return packages;
+}
+
+auto Cache_db::count_refreshed_packages(char letter, const Scan_marker& marker) -> int64_t
+{
+    auto bounds = letter_bounds(letter);
+    auto row = select_one(R"(
+        SELECT COUNT(*)
+        FROM dict_names
+        JOIN packages3 ON packages3.name_id = dict_names.id
+        WHERE packages3.id <= ?1 AND last_poll >= ?2
+            AND ((dict_names.value >= ?3 AND dict_names.value < ?4) OR (dict_names.value >= ?5 AND dict_names.value < ?6))
+    )", { marker.max_id, marker.start, bounds[0], bounds[1], bounds[2], bounds[3] });
+    return std::get<1>(row[0]);
+}
+
+auto Cache_db::begin_scan(std::string_view remote, char letter) -> int64_t
+{
+    execute(insert_scan_gen, { std::string{remote}, std::string(1, static_cast<char>(toupper(letter))) });
+    return sqlite3_last_insert_rowid(handle());
+}
+
+auto Cache_db::sweep_packages(std::string_view remote, char letter, int64_t scan_gen) -> std::vector<Package_list_entry>
+{
+    std::vector<Package_list_entry> removed;
+
+    auto bounds = letter_bounds(letter);
+    while (execute(sweep_packages_stmt, { std::string{remote}, bounds[0], bounds[1], bounds[2], bounds[3], scan_gen }))
+        removed.push_back(package_entry_from_row(row_view(sweep_packages_stmt)));
+
+    execute(complete_scan_gen, { scan_gen, static_cast<int64_t>(removed.size()) });
+    execute(cached_statement("DELETE FROM scan_searches WHERE gen = ?1"), { scan_gen });
+
+    // The names that no remote has any more
+    if (!removed.empty()) {
+        execute(cached_statement(R"(
+            DELETE FROM dict_names
+            WHERE ((value >= ?1 AND value < ?2) OR (value >= ?3 AND value < ?4))
+                AND NOT EXISTS (SELECT 1 FROM packages3 WHERE name_id = dict_names.id)
+        )"), { bounds[0], bounds[1], bounds[2], bounds[3] });
+    }
+
+    return removed;
+}
+
+auto Cache_db::get_resumable_scan(std::string_view remote, char letter) -> int64_t
+{
+    int64_t scan_gen = 0;
+    while (execute(get_resumable_scan_stmt, { std::string{remote}, std::string(1, static_cast<char>(toupper(letter))) })) {
+        auto row = get_row(get_resumable_scan_stmt);
+        if (std::get<1>(row[1]) != 0) scan_gen = std::get<1>(row[0]);
+    }
+    return scan_gen;
+}
+
+auto Cache_db::get_completed_searches(int64_t scan_gen) -> std::map<std::string, Completed_search>
+{
+    std::map<std::string, Completed_search> searches;
+    while (execute(get_completed_searches_stmt, { scan_gen })) {
+        auto row = get_row(get_completed_searches_stmt);
+        searches[std::get<3>(row[0])] = { std::get<1>(row[1]), std::get<1>(row[2]) };
+    }
+    return searches;
+}
+
+void Cache_db::mark_search_completed(int64_t scan_gen, std::string_view pattern, const Completed_search& search)
+{
+    execute(mark_search_completed_stmt, { scan_gen, std::string{pattern}, search.results, search.duration_ms });
+}
+
+void Cache_db::mark_scan_failed(int64_t scan_gen, std::string_view failure)
+{
+    execute(mark_scan_failed_stmt, { scan_gen, std::string{failure} });
+}
+
+void Cache_db::record_remote_failure(std::string_view remote, std::string_view kind, std::string_view message)
+{
+    execute(record_remote_failure_stmt, { std::string{remote}, std::string{kind}, std::string{message} });
+}
+
+void Cache_db::record_remote_success(std::string_view remote)
+{
+    execute(record_remote_success_stmt, { std::string{remote} });
+}
+
+auto Cache_db::get_remote_failures() -> std::vector<Remote_failure>
+{
+    std::vector<Remote_failure> failures;
+    auto stmt = cached_statement(R"(
+        SELECT remote, kind, message, consecutive, last_failure, IFNULL(last_success, '')
+        FROM remote_failures
+        WHERE consecutive > 0
+        ORDER BY remote
+    )");
+    while (execute(stmt, {})) {
+        auto row = get_row(stmt);
+        failures.push_back({ std::get<3>(row[0]), std::get<3>(row[1]), std::get<3>(row[2]), std::get<1>(row[3]),
+            std::get<3>(row[4]), std::get<3>(row[5]) });
+    }
+    return failures;
+}
+
+auto Cache_db::get_remotes() -> std::vector<Remote_entry>
+{
+    std::vector<Remote_entry> remotes;
+    while (execute(get_remotes_stmt, {})) {
+        auto row = get_row(get_remotes_stmt);
+        remotes.push_back({ std::get<3>(row[0]), std::get<3>(row[1]), std::get<1>(row[2]) != 0, std::get<1>(row[3]) != 0,
+            std::get<1>(row[4]), std::get<3>(row[5]), std::get<1>(row[6]) != 0 });
+    }
+    return remotes;
+}
+
+void Cache_db::replace_remotes(const std::vector<Remote_entry>& remotes)
+{
+    auto known = get_remotes();
+
+    for (auto& remote: remotes)
+        execute(upsert_remote_stmt, { remote.name, remote.url, int64_t{remote.verify_ssl}, int64_t{remote.enabled}, remote.priority });
+    for (auto& remote: known)
+        if (std::none_of(remotes.begin(), remotes.end(), [&](auto& r) { return r.name == remote.name; }))
+            execute(delete_remote_stmt, { remote.name });
+}
+
+void Cache_db::record_remote_health(std::string_view remote, bool healthy)
+{
+    execute(record_remote_health_stmt, { std::string{remote}, int64_t{healthy} });
+}
+
+auto Cache_db::get_prefix_results(std::string_view remote) -> std::map<std::string, int64_t>
+{
+    std::map<std::string, int64_t> results;
+    while (execute(get_prefix_results_stmt, { std::string{remote} })) {
+        auto row = get_row(get_prefix_results_stmt);
+        results[std::get<3>(row[0])] = std::get<1>(row[1]);
+    }
+    return results;
+}
+
+void Cache_db::update_prefix_stats(std::string_view remote, std::string_view prefix, int64_t results, int64_t duration_ms)
+{
+    execute(upsert_prefix_stats, { std::string{remote}, std::string{prefix}, results, duration_ms });
+}
+
+auto Cache_db::refill_crawl_queue() -> int64_t
+{
+    execute(R"(
+        DELETE FROM crawl_queue
+        WHERE NOT EXISTS (SELECT 1 FROM packages3 WHERE packages3.id = crawl_queue.pkg_id)
+            OR EXISTS (SELECT 1 FROM pkg_info WHERE pkg_info.pkg_id = crawl_queue.pkg_id)
+    )", "trying to clean up the crawl queue");
+
+    // (Packages already queued keep their rank and attempts)
+    execute(std::format(R"(
+        INSERT OR IGNORE INTO crawl_queue (pkg_id, rank)
+        SELECT id, ROW_NUMBER() OVER (PARTITION BY name_id, remote_id, user_id, channel_id ORDER BY {0} DESC, version DESC)
+        FROM packages3
+        WHERE NOT EXISTS (SELECT 1 FROM pkg_info WHERE pkg_info.pkg_id = packages3.id)
+    )", version_key), "trying to fill the crawl queue");
+
+    return sqlite3_changes(handle());
+}
+
+auto Cache_db::get_crawl_batch(size_t count, int64_t max_attempts) -> std::vector<Package_list_entry>
+{
+    std::vector<Package_list_entry> batch;
+    while (execute(get_crawl_batch_stmt, { max_attempts, static_cast<int64_t>(count) }))
+        batch.push_back(package_entry_from_row(row_view(get_crawl_batch_stmt)));
+    return batch;
+}
+
+auto Cache_db::count_crawl_remaining(int64_t max_attempts) -> int64_t
+{
+    auto row = select_one(R"(
+        SELECT COUNT(*) FROM crawl_queue
+        WHERE attempts < ?1 AND NOT EXISTS (SELECT 1 FROM pkg_info WHERE pkg_info.pkg_id = crawl_queue.pkg_id)
+    )", { max_attempts });
+    return std::get<1>(row[0]);
+}
+
+void Cache_db::mark_crawl_failed(int64_t pkg_id)
+{
+    execute(mark_crawl_failed_stmt, { pkg_id });
+}
+
+void Cache_db::remove_from_crawl_queue(int64_t pkg_id)
+{
+    execute(remove_from_crawl_queue_stmt, { pkg_id });
+}
+
+auto Cache_db::get_crawler_state() -> Crawler_state
+{
+    Crawler_state state;
+    auto row = select_one("SELECT COUNT(*), MAX(enabled), MAX(done), MAX(failed) FROM crawler_state");
+    if (std::get<1>(row[0]) > 0) {
+        state.enabled = std::get<1>(row[1]) != 0;
+        state.done    = std::get<1>(row[2]);
+        state.failed  = std::get<1>(row[3]);
+    }
+    return state;
+}
+
+void Cache_db::save_crawler_state(const Crawler_state& state)
+{
+    execute(save_crawler_state_stmt, { static_cast<int64_t>(state.enabled), state.done, state.failed });
+}
+
+auto Cache_db::get_response(std::string_view remote, std::string_view command, int64_t max_age) -> std::optional<std::string>
+{
+    std::optional<std::string> output;
+    if (execute(get_response_stmt, { std::string{remote}, std::string{command}, std::format("-{0} seconds", max_age) })) {
+        auto row = get_row(get_response_stmt);
+        output = decompress_text(std::get<SQLite::Blob>(row[0]), static_cast<size_t>(std::get<int64_t>(row[1])));
+    }
+    sqlite3_reset(get_response_stmt);
+    return output;
+}
+
+void Cache_db::store_response(std::string_view remote, std::string_view command, std::string_view output)
+{
+    execute(store_response_stmt, { std::string{remote}, std::string{command}, compress_text(output), static_cast<int64_t>(output.size()) });
+}
+
+auto Cache_db::invalidate_responses(std::string_view remote) -> int64_t
+{
+    auto stmt = cached_statement("DELETE FROM responses WHERE ?1 = '' OR remote = ?1");
+    execute(stmt, { std::string{remote} });
+    return sqlite3_changes(handle());
+}
+
+auto Cache_db::upsert_package_and_info(std::string_view remote, const Package_reference& reference, const Package_info& info, int64_t scan_gen) -> int64_t
+{
+    auto pkg_id = upsert_package(remote, reference.package, reference.version, reference.user, reference.channel, scan_gen);
+    upsert_package_info(pkg_id, info);
+    return pkg_id;
+}
+
+bool Cache_db::remove_package(std::string_view remote, const Package_reference& reference)
+{
+    execute(remove_package_stmt, { std::string{remote}, reference.package, reference.version, reference.user, reference.channel });
+    return sqlite3_changes(handle()) > 0;
+}
@@ -1,33 +1,260 @@
 #pragma once
 
+#include <array>
+#include <map>
 #include <optional>
+#include <span>
 #include "./types.h"
 #include "./sqlite_wrapper/database.h"
+#include "./sqlite_wrapper/statement.h"
 
 
 struct Package_list_entry: Package_key {
     int64_t id;
 };
 
+// A row of get_list() and get_versions(): a package, and its info if it has been read (the strings point into
+// SQLite's buffers, they are only valid during the callback)
+struct Package_row {
+    int64_t                         id;
+    std::string_view                name, remote, user, channel, version;
+    std::optional<std::string_view> description;    // none if there is no info
+    std::string_view                license, provides, author;     // (see get_topics() for the topics)
+    std::optional<int64_t>          info_age;       // seconds since the info was read
+};
+
+// Summary of a node of the package tree (letter, reference, remote, user or channel), obtained
+// through an aggregate query without loading the node's children.
+struct Tree_aggregate {
+    std::string label;          // name, remote, user or channel (or the letter)
+    int64_t     children = 0;   // number of distinct child nodes
+    int64_t     versions = 0;   // number of package versions below the node
+    std::string latest;         // highest version below the node (by SEMVER_KEY)
+};
+
+// A topic, with the number of package versions that have it
+struct Topic_facet {
+    std::string topic;
+    int64_t     packages = 0;
+};
+
+// State of the cache before a scan, so that the rows the scan inserted or refreshed can be told apart afterwards
+struct Scan_marker {
+    int64_t     max_id = 0;     // highest package id before the scan
+    std::string start;          // start time of the scan (same format as last_poll)
+};
+
+// Last failure of the calls to a remote (a success resets the count of consecutive failures)
+struct Remote_failure {
+    std::string remote;
+    std::string kind;           // see Conan::failure_name()
+    std::string message;
+    int64_t     consecutive = 0;
+    std::string last_failure;
+    std::string last_success;
+};
+
+// Outcome of one search of a scan that completed, kept until the scan is swept so that a failed or
+// interrupted scan can resume where it stopped
+struct Completed_search {
+    int64_t     results = 0;
+    int64_t     duration_ms = 0;
+};
+
+// Persistent state of the info crawler
+struct Crawler_state {
+    bool        enabled = true;
+    int64_t     done = 0;
+    int64_t     failed = 0;
+};
+
+// Progress of a backfill (see run_backfill_chunk())
+struct Backfill_progress {
+    std::string name;
+    int64_t     last_id = 0;    // last row done
+    int64_t     rows_done = 0;
+    int64_t     rows_total = 0; // rows when the migration was applied
+    bool        finished = false;
+};
+
 class Cache_db: public SQLite::Database {
 public:
     Cache_db();
     ~Cache_db();
 
+    // Applies the schema migrations the database has not had yet (at construction)
     void create_or_update();
 
+    // Backfills left by the migrations: run_backfill_chunk() runs the next chunk of the first one that is not
+    // finished (within the caller's transaction) and returns its progress, none once they all are
+    auto run_backfill_chunk(size_t rows) -> std::optional<Backfill_progress>;
+    auto get_backfills() -> std::vector<Backfill_progress>;
+
     // TODO: replace with coro generator interface
-    void get_list(std::function<bool(SQLite::Row)> row_cb, std::string_view name_filter = "%");
-    void upsert_package(std::string_view remote, std::string_view name, std::string_view version, std::string_view user, std::string_view channel);
+    void get_list(const std::function<bool(const Package_row&)>& row_cb, std::string_view name_filter = "%");
+
+    // Keyset pagination: the reference aggregates of a letter that come after the last one of the previous page
+    // (none for the first page). Every page is a range scan of the names (and of packages3_tree for each of them)
+    // starting at that key, so that a list can be streamed page by page, from any number of connections, and
+    // abandoned at any point.
+    auto get_reference_page(char letter, std::string_view after, size_t page_size) -> std::vector<Tree_aggregate>;
+    // Returns the package id
+    auto upsert_package(std::string_view remote, std::string_view name, std::string_view version, std::string_view user, std::string_view channel, int64_t scan_gen = 0) -> int64_t;
+
+    // Aggregates for each level of the package tree (all backed by the packages3_tree covering index)
+    auto get_letter_aggregates() -> std::map<char, Tree_aggregate>;
+    auto get_reference_aggregates(char letter) -> std::vector<Tree_aggregate>;
+    auto get_reference_aggregate(std::string_view name) -> std::optional<Tree_aggregate>;
+    auto get_remote_aggregates(std::string_view name) -> std::vector<Tree_aggregate>;
+    auto get_user_aggregates(std::string_view name, std::string_view remote) -> std::vector<Tree_aggregate>;
+    auto get_channel_aggregates(std::string_view name, std::string_view remote, std::string_view user) -> std::vector<Tree_aggregate>;
+
+    // Versions of one reference/remote/user/channel combination, newest first, joined with pkg_info
+    // (same columns as get_list())
+    void get_versions(
+        const std::function<bool(const Package_row&)>& row_cb,
+        std::string_view name, std::string_view remote, std::string_view user, std::string_view channel
+    );
 
     auto get_package_info(int64_t pkg_id) -> std::optional<Package_info>;
     void upsert_package_info(int64_t pkg_id, const Package_info&);
 
+    // Topics (through the pkg_topics_topic index): the facets (the most frequent topics first), the references
+    // that have a topic (aggregated like get_reference_aggregates(), all letters), and the topics of packages
+    // (by package id, in alphabetical order; packages without topics are left out)
+    auto get_topic_facets() -> std::vector<Topic_facet>;
+    auto get_topic_references(std::string_view topic) -> std::vector<Tree_aggregate>;
+    auto get_topics(std::span<const int64_t> pkg_ids) -> std::map<int64_t, std::vector<std::string>>;
+
+    // The other inspect attributes of packages (see Package_info::attributes), in one query: by package id,
+    // those of the given keys (all if there are none); packages without any are left out
+    auto get_attributes(std::span<const int64_t> pkg_ids, std::span<const std::string_view> keys = {})
+        -> std::map<int64_t, std::map<std::string, std::string>>;
+
+    // For packages whose info is known along with them (e.g. those of the local cache); returns the package id
+    auto upsert_package_and_info(std::string_view remote, const Package_reference&, const Package_info&, int64_t scan_gen = 0) -> int64_t;
+    bool remove_package(std::string_view remote, const Package_reference&);     // false if there was no such package
+
     void mark_letter_as_scanned(char letter);
 
+    // Scan generations: the packages found by a scan of a remote are stamped with the scan's generation, so
+    // that once the scan has succeeded, the packages of the scanned range it did not find can be swept (along
+    // with their pkg_info). Returns the packages deleted.
+    auto begin_scan(std::string_view remote, char letter) -> int64_t;
+    auto sweep_packages(std::string_view remote, char letter, int64_t scan_gen) -> std::vector<Package_list_entry>;
+
+    // Resuming scans: the latest scan of a remote's letter, if it never got swept and is recent enough (a
+    // day) to be resumed, 0 otherwise; the searches of a scan that completed (by pattern); why a scan failed
+    auto get_resumable_scan(std::string_view remote, char letter) -> int64_t;
+    auto get_completed_searches(int64_t scan_gen) -> std::map<std::string, Completed_search>;
+    void mark_search_completed(int64_t scan_gen, std::string_view pattern, const Completed_search&);
+    void mark_scan_failed(int64_t scan_gen, std::string_view failure);
+
+    // Health of the remotes
+    void record_remote_failure(std::string_view remote, std::string_view kind, std::string_view message);
+    void record_remote_success(std::string_view remote);
+    auto get_remote_failures() -> std::vector<Remote_failure>;   // remotes whose last call failed
+
+    // The remotes, by priority; replace_remotes() stores the list read from conan (dropping the remotes that
+    // are no longer in it, but keeping the health of the others); it is meant to run as one Cache_writer mutation
+    auto get_remotes() -> std::vector<Remote_entry>;
+    void replace_remotes(const std::vector<Remote_entry>&);
+    void record_remote_health(std::string_view remote, bool healthy);
+
+    // Statistics of the searches of a remote by name prefix (lowercase, as searches are case-insensitive);
+    // the count of a prefix that was split into sub-prefixes is the sum of theirs
+    auto get_prefix_results(std::string_view remote) -> std::map<std::string, int64_t>;
+    void update_prefix_stats(std::string_view remote, std::string_view prefix, int64_t results, int64_t duration_ms);
+
+    // Crawl queue: the packages that have no info yet, ranked by version within their channel (newest first).
+    // refill_crawl_queue() adds the packages that appeared since it was last called, and drops the ones that
+    // got their info (or were purged) in the meantime.
+    auto refill_crawl_queue() -> int64_t;
+    auto get_crawl_batch(size_t count, int64_t max_attempts) -> std::vector<Package_list_entry>;
+    auto count_crawl_remaining(int64_t max_attempts) -> int64_t;
+    void mark_crawl_failed(int64_t pkg_id);
+    void remove_from_crawl_queue(int64_t pkg_id);
+    auto get_crawler_state() -> Crawler_state;
+    void save_crawler_state(const Crawler_state&);
+
+    // Memoized conan responses (successful ones only), keyed by remote and normalized command line; the
+    // output is stored compressed. get_response() ignores responses older than max_age (seconds).
+    auto get_response(std::string_view remote, std::string_view command, int64_t max_age) -> std::optional<std::string>;
+    void store_response(std::string_view remote, std::string_view command, std::string_view output);
+    auto invalidate_responses(std::string_view remote = {}) -> int64_t;    // all remotes if empty
+
+    // Changes brought by a scan of a letter: packages inserted since the marker was taken (ordered like the
+    // tree), and number of pre-existing packages that the scan found again
+    auto get_scan_marker() -> Scan_marker;
+    auto get_added_packages(char letter, const Scan_marker&) -> std::vector<Package_list_entry>;
+    auto count_refreshed_packages(char letter, const Scan_marker&) -> int64_t;
+
 private:
-    sqlite3_stmt *      get_list_stmt = nullptr;
-    sqlite3_stmt *      get_pkg_info = nullptr;
-    sqlite3_stmt *      upsert_pkg_info = nullptr;
-    sqlite3_stmt *      upsert_letter_scan_time = nullptr;
+    // Dictionary tables of the strings of the package keys, of the topics and of the attribute keys (see schema
+    // versions 23, 25 and 26); intern() returns the id of a value, adding it if needed
+    enum class Dictionary { remotes, names, users, channels, topics, attr_keys };
+    static constexpr std::array<std::string_view, 6> dictionary_tables = { "dict_remotes", "dict_names", "dict_users", "dict_channels", "dict_topics",
+        "dict_attr_keys" };
+
+    auto intern(Dictionary, std::string_view value) -> int64_t;
+    bool backfill_finished(std::string_view name);
+    auto get_aggregates(sqlite3_stmt*, std::initializer_list<SQLite::Value> values) -> std::vector<Tree_aggregate>;
+
+    // Runs a statement that takes a list of package ids (as ?1 to ?id_list_size, in "IN ()") for every chunk of
+    // the ids, calling fn() for every row; the ids of dictionary values (at most key_list_size), if any, follow
+    static constexpr size_t id_list_size = 64, key_list_size = 16;
+    void for_each_id_chunk(sqlite3_stmt*, std::span<const int64_t> ids, const std::function<void(const SQLite::Row_view&)>& fn,
+        std::span<const int64_t> key_ids = {});
+
+    // (Columns of Package_row)
+    using Package_columns = std::tuple<int64_t, std::string_view, std::string_view, std::string_view, std::string_view, std::string_view,
+        std::optional<std::string_view>, std::string_view, std::string_view, std::string_view, std::optional<int64_t>>;
+
+    // (The statements are declared by the constructor, but only prepared the first time they are used: most
+    // connections are short-lived, and run a handful of them)
+    SQLite::Statement<Package_columns(std::string_view)> get_list_stmt;
+    SQLite::Statement<Package_columns(std::string_view, std::string_view, std::string_view, std::string_view)> get_versions_stmt;
+    SQLite::Statement<std::tuple<std::string, std::string, std::string, std::string, std::string, std::string>(int64_t)> get_pkg_info;
+    SQLite::Statement<std::tuple<>(int64_t, std::string_view, std::string_view, std::string_view, std::string_view,
+        std::optional<std::string_view>)> upsert_pkg_info;
+    SQLite::Statement<std::tuple<>(int64_t)> delete_pkg_topics;
+    SQLite::Statement<std::tuple<>(int64_t, int64_t)> insert_pkg_topic;
+    SQLite::Deferred_statement get_topics_stmt, get_topic_lists_stmt;
+    SQLite::Statement<std::tuple<>(int64_t)> delete_pkg_attrs;
+    SQLite::Statement<std::tuple<>(int64_t, int64_t, std::string_view)> insert_pkg_attr;
+    SQLite::Deferred_statement get_attributes_stmt, get_all_attributes_stmt;
+    bool                topics_moved = false;   // whether pkg_info.topics has been emptied by the "topics" backfill
+    std::string_view    version_key;    // sort key of the versions in queries: the semver_key column, or SEMVER_KEY(version)
+    std::array<SQLite::Statement<std::tuple<int64_t>(std::string_view)>, dictionary_tables.size()> find_value_stmts, insert_value_stmts;
+    SQLite::Statement<std::tuple<int64_t>(int64_t, int64_t, int64_t, int64_t, std::string_view, int64_t)> upsert_package_stmt;
+    SQLite::Statement<std::tuple<std::string, int64_t, int64_t, std::string, std::optional<int64_t>>(std::string_view, std::string_view,
+        std::string_view, int64_t)> get_reference_page_stmt;
+    SQLite::Deferred_statement reference_aggregates_stmt;
+    SQLite::Deferred_statement reference_aggregate_stmt;
+    SQLite::Deferred_statement remote_aggregates_stmt;
+    SQLite::Deferred_statement user_aggregates_stmt;
+    SQLite::Deferred_statement channel_aggregates_stmt;
+    SQLite::Deferred_statement upsert_letter_scan_time;
+    SQLite::Deferred_statement insert_scan_gen;
+    SQLite::Deferred_statement sweep_packages_stmt;
+    SQLite::Deferred_statement complete_scan_gen;
+    SQLite::Deferred_statement get_resumable_scan_stmt;
+    SQLite::Deferred_statement get_completed_searches_stmt;
+    SQLite::Deferred_statement mark_search_completed_stmt;
+    SQLite::Deferred_statement mark_scan_failed_stmt;
+    SQLite::Deferred_statement record_remote_failure_stmt;
+    SQLite::Deferred_statement record_remote_success_stmt;
+    SQLite::Deferred_statement get_remotes_stmt;
+    SQLite::Deferred_statement upsert_remote_stmt;
+    SQLite::Deferred_statement delete_remote_stmt;
+    SQLite::Deferred_statement record_remote_health_stmt;
+    SQLite::Deferred_statement get_prefix_results_stmt;
+    SQLite::Deferred_statement upsert_prefix_stats;
+    SQLite::Deferred_statement get_crawl_batch_stmt;
+    SQLite::Deferred_statement mark_crawl_failed_stmt;
+    SQLite::Deferred_statement remove_from_crawl_queue_stmt;
+    SQLite::Deferred_statement save_crawler_state_stmt;
+    SQLite::Deferred_statement get_response_stmt;
+    SQLite::Deferred_statement remove_package_stmt;
+    SQLite::Deferred_statement store_response_stmt;
 };
\ No newline at end of file
@@ -0,0 +1,181 @@
+#include <algorithm>
+#include <iostream>
+#include "./cache_writer.h"
+
+
+Cache_writer::~Cache_writer()
+{
+    // (What is queued still gets written)
+    {
+        auto lock = std::unique_lock{mutex};
+        term_flag = true;
+    }
+    if (worker.joinable()) {
+        cond_var.notify_one();
+        worker.join();
+    }
+}
+
+void Cache_writer::configure(Writer_options options_)
+{
+    {
+        auto lock = std::unique_lock{mutex};
+        options = options_;
+        options.max_batch = std::max<size_t>(1, options.max_batch);
+        options.backfill_chunk = std::max<size_t>(1, options.backfill_chunk);
+    }
+    start();
+}
+
+void Cache_writer::start()
+{
+    auto lock = std::unique_lock{mutex};
+    if (!worker.joinable())
+        worker = std::thread{[this]() { write_batches(); }};
+}
+
+void Cache_writer::queue(Mutation&& mutation)
+{
+    mutation.queued = Clock::now();
+
+    {
+        auto lock = std::unique_lock{mutex};
+        mutations.push_back(std::move(mutation));
+    }
+    start();
+    cond_var.notify_one();
+}
+
+void Cache_writer::write_batches()
+{
+    Cache_db db;
+    auto backfilling = true;    // (until the database has nothing left to backfill)
+
+    for (;;) {
+        std::vector<Mutation> batch;
+        {
+            auto lock = std::unique_lock{mutex};
+            if (!backfilling)
+                cond_var.wait(lock, [this]() { return !mutations.empty() || term_flag; });
+            if (mutations.empty()) {
+                if (term_flag) return;
+                lock.unlock();
+                backfilling = run_backfill(db);
+                lock.lock();
+                if (backfilling)
+                    cond_var.wait_for(lock, options.backfill_pause, [this]() { return !mutations.empty() || term_flag; });
+                continue;
+            }
+
+            // Wait for the batch to fill up, until the oldest mutation has waited long enough
+            auto deadline = mutations.front().queued + options.max_delay;
+            cond_var.wait_until(lock, deadline, [this]() { return mutations.size() >= options.max_batch || term_flag; });
+
+            auto count = std::min(mutations.size(), options.max_batch);
+            std::move(mutations.begin(), mutations.begin() + count, std::back_inserter(batch));
+            mutations.erase(mutations.begin(), mutations.begin() + count);
+        }
+        run_batch(db, batch);
+    }
+}
+
+void Cache_writer::run_batch(Cache_db& db, std::vector<Mutation>& batch)
+{
+    auto start = Clock::now();
+
+    std::vector<Mutation*> applied;
+    size_t next = 0;    // (the mutations from there on have not run yet)
+    int64_t failed = 0;
+    try {
+        db.execute("BEGIN IMMEDIATE", "trying to begin a write batch");
+        for (; next < batch.size(); ++next) {
+            auto& mutation = batch[next];
+            db.execute("SAVEPOINT mutation", "trying to begin a mutation");
+            try {
+                mutation.apply(db);
+                db.execute("RELEASE mutation", "trying to release a mutation");
+                applied.push_back(&mutation);
+            }
+            catch (...) {
+                db.execute("ROLLBACK TO mutation", "trying to roll back a mutation");
+                db.execute("RELEASE mutation", "trying to release a mutation");
+                mutation.failed(std::current_exception());
+                ++failed;
+            }
+        }
+        db.execute("COMMIT", "trying to commit a write batch");
+    }
+    catch (const std::exception& e) {
+        // (Every mutation that is not resolved yet fails with the error of the batch)
+        std::cerr << "***Write batch failed: " << e.what() << std::endl;
+        try { db.execute("ROLLBACK"); } catch (...) {}
+        for (auto i = next; i < batch.size(); i++)
+            applied.push_back(&batch[i]);
+        for (auto mutation: applied)
+            mutation->failed(std::current_exception());
+        failed += static_cast<int64_t>(applied.size());
+        applied.clear();
+    }
+
+    auto end = Clock::now();
+    for (auto mutation: applied)
+        mutation->committed();
+
+    auto lock = std::unique_lock{mutex};
+    auto commit_ms = std::chrono::duration<double, std::milli>(end - start).count();
+    mutation_count += static_cast<int64_t>(batch.size());
+    failed_count += failed;
+    ++transaction_count;
+    max_batch = std::max(max_batch, static_cast<int64_t>(batch.size()));
+    commit_ms_total += commit_ms;
+    max_commit_ms = std::max(max_commit_ms, commit_ms);
+    for (auto& mutation: batch)
+        wait_ms_total += std::chrono::duration<double, std::milli>(end - mutation.queued).count();
+}
+
+bool Cache_writer::run_backfill(Cache_db& db)
+{
+    size_t rows;
+    {
+        auto lock = std::unique_lock{mutex};
+        rows = options.backfill_chunk;
+    }
+
+    std::optional<Backfill_progress> progress;
+    try {
+        db.execute("BEGIN IMMEDIATE", "trying to begin a backfill chunk");
+        try {
+            progress = db.run_backfill_chunk(rows);
+            db.execute("COMMIT", "trying to commit a backfill chunk");
+        }
+        catch (...) {
+            db.execute("ROLLBACK", "trying to roll back a backfill chunk");
+            throw;
+        }
+    }
+    catch (const std::exception& e) {
+        // (It will be resumed by the next session)
+        std::cerr << "***Backfill failed: " << e.what() << std::endl;
+        return false;
+    }
+
+    if (progress && progress->finished)
+        std::cout << "Cache schema: backfill \"" << progress->name << "\" finished (" << progress->rows_done << " rows)" << std::endl;
+    auto lock = std::unique_lock{mutex};
+    if (progress) backfill = progress;
+    return progress.has_value();
+}
+
+auto Cache_writer::stats() -> Writer_stats
+{
+    auto lock = std::unique_lock{mutex};
+    Writer_stats stats{ .mutations = mutation_count, .failed = failed_count, .transactions = transaction_count, .max_batch = max_batch,
+        .max_commit_ms = max_commit_ms, .queued = mutations.size(), .backfill = backfill };
+    if (transaction_count > 0) {
+        stats.mean_batch = static_cast<double>(mutation_count) / transaction_count;
+        stats.mean_commit_ms = commit_ms_total / transaction_count;
+    }
+    if (mutation_count > 0)
+        stats.mean_wait_ms = wait_ms_total / mutation_count;
+    return stats;
+}
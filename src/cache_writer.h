@@ -0,0 +1,122 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "./cache_db.h"
+
+
+struct Writer_options {
+    size_t                      max_batch = 256;    // mutations per transaction
+    std::chrono::milliseconds   max_delay{ 20 };    // how long a mutation can wait for others to share its transaction
+    size_t                      backfill_chunk = 5000;  // rows per transaction of the backfills
+    std::chrono::milliseconds   backfill_pause{ 50 };   // between the chunks, when the other connections can write
+};
+
+struct Writer_stats {
+    int64_t     mutations = 0;
+    int64_t     failed = 0;         // mutations that threw (and were rolled back)
+    int64_t     transactions = 0;
+    int64_t     max_batch = 0;
+    double      mean_batch = 0;
+    double      mean_commit_ms = 0; // duration of the transactions, from BEGIN to COMMIT
+    double      max_commit_ms = 0;
+    double      mean_wait_ms = 0;   // from queuing to commit
+    size_t      queued = 0;
+    std::optional<Backfill_progress> backfill;      // the last one that ran
+};
+
+/**
+ * The single writer of the cache database: mutations are queued, and run by a dedicated thread on its own
+ * connection, in transactions that group as many of them as arrive within max_delay (up to max_batch). Each
+ * mutation runs within a savepoint, so that one that throws is rolled back alone. The futures become ready
+ * once the transaction is committed, with the mutation's result (or its exception).
+ *
+ * Mutations must not begin transactions of their own.
+ *
+ * When there is nothing to write, the writer runs the backfills of the schema migrations, one chunk (and
+ * transaction) at a time, pausing for backfill_pause after each (or until a mutation is queued) so that it
+ * does not hold the write lock of the database the whole time.
+ */
+class Cache_writer {
+public:
+
+    // (Construct it before the other singletons that write through it, so that it outlives them)
+    static auto& instance() {
+        static Cache_writer _instance; return _instance;
+    }
+
+    ~Cache_writer();
+
+    void configure(Writer_options);     // (starts the writer, and with it the backfills)
+
+    template <typename Fn>
+    auto write(Fn fn) -> std::future<std::invoke_result_t<Fn, Cache_db&>>;
+
+    auto stats() -> Writer_stats;
+
+private:
+
+    using Clock = std::chrono::steady_clock;
+
+    struct Mutation {
+        std::function<void(Cache_db&)>          apply;
+        std::function<void()>                   committed;
+        std::function<void(std::exception_ptr)> failed;
+        Clock::time_point                       queued;
+    };
+
+    Cache_writer() = default;
+
+    void start();
+    void queue(Mutation&&);
+    void write_batches();
+    void run_batch(Cache_db&, std::vector<Mutation>&);
+    bool run_backfill(Cache_db&);   // false once there is nothing left to backfill
+
+    std::mutex                  mutex;
+    std::condition_variable     cond_var;
+    std::deque<Mutation>        mutations;
+    Writer_options              options;
+    std::thread                 worker;
+    bool                        term_flag = false;
+
+    // Statistics (protected by the mutex)
+    int64_t                     mutation_count = 0, failed_count = 0, transaction_count = 0, max_batch = 0;
+    double                      commit_ms_total = 0, max_commit_ms = 0, wait_ms_total = 0;
+    std::optional<Backfill_progress> backfill;
+};
+
+template <typename Fn>
+auto Cache_writer::write(Fn fn) -> std::future<std::invoke_result_t<Fn, Cache_db&>>
+{
+    using Result = std::invoke_result_t<Fn, Cache_db&>;
+
+    auto promise = std::make_shared<std::promise<Result>>();
+    auto future = promise->get_future();
+    if constexpr (std::is_void_v<Result>) {
+        queue({
+            [fn = std::move(fn)](Cache_db& db) mutable { fn(db); },
+            [promise]() { promise->set_value(); },
+            [promise](std::exception_ptr e) { promise->set_exception(e); }
+        });
+    }
+    else {
+        auto result = std::make_shared<std::optional<Result>>();
+        queue({
+            [fn = std::move(fn), result](Cache_db& db) mutable { result->emplace(fn(db)); },
+            [promise, result]() { promise->set_value(std::move(**result)); },
+            [promise](std::exception_ptr e) { promise->set_exception(e); }
+        });
+    }
+    return future;
+}
@@ -0,0 +1,104 @@
+#include <cstdint>
+#include <stdexcept>
+#include <thread>
+#include <format>
+#include "./command_archive.h"
+
+
+namespace Conan {
+
+    static constexpr std::string_view magic = "CONAN-GUI-REC 1\n";
+
+    template <typename T>
+    static void write_int(std::ostream& os, T value)
+    {
+        for (auto i = 0U; i < sizeof(T); i++) os.put(static_cast<char>((static_cast<uint64_t>(value) >> (8 * i)) & 0xff));
+    }
+
+    template <typename T>
+    static auto read_int(std::istream& is) -> T
+    {
+        uint64_t value = 0;
+        for (auto i = 0U; i < sizeof(T); i++) value |= static_cast<uint64_t>(static_cast<uint8_t>(is.get())) << (8 * i);
+        return static_cast<T>(value);
+    }
+
+    static void write_string(std::ostream& os, std::string_view s)
+    {
+        write_int<uint32_t>(os, static_cast<uint32_t>(s.size()));
+        os.write(s.data(), s.size());
+    }
+
+    static auto read_string(std::istream& is) -> std::string
+    {
+        std::string s(read_int<uint32_t>(is), '\0');
+        is.read(s.data(), s.size());
+        return s;
+    }
+
+    auto Command_archive::create(const std::string& filename) -> Command_archive
+    {
+        Command_archive archive;
+        archive.out.open(filename, std::ios::binary | std::ios::trunc);
+        if (!archive.out) throw std::runtime_error(std::format("Unable to create command archive \"{0}\"", filename));
+        archive.out.write(magic.data(), magic.size());
+        return archive;
+    }
+
+    auto Command_archive::open(const std::string& filename) -> Command_archive
+    {
+        std::ifstream is{ filename, std::ios::binary };
+        if (!is) throw std::runtime_error(std::format("Unable to open command archive \"{0}\"", filename));
+
+        std::string header(magic.size(), '\0');
+        is.read(header.data(), header.size());
+        if (header != magic) throw std::runtime_error(std::format("\"{0}\" is not a command archive", filename));
+
+        Command_archive archive;
+        while (is.peek() != std::char_traits<char>::eof()) {
+            auto args = read_string(is);
+            Command_result result;
+            result.output    = read_string(is);
+            result.errors    = read_string(is);
+            result.exit_code = read_int<int32_t>(is);
+            (void)read_int<uint64_t>(is); // start time: informational only
+            result.duration  = std::chrono::microseconds{ read_int<uint64_t>(is) };
+            if (!is) throw std::runtime_error(std::format("Command archive \"{0}\" is truncated", filename));
+            archive.entries[args].push_back(std::move(result));
+            ++archive.entry_count;
+        }
+        return archive;
+    }
+
+    void Command_archive::record(std::string_view args, const Command_result& result, std::chrono::steady_clock::time_point start)
+    {
+        auto lock = std::unique_lock{ *mutex };
+        write_string(out, args);
+        write_string(out, result.output);
+        write_string(out, result.errors);
+        write_int<int32_t>(out, result.exit_code);
+        write_int<uint64_t>(out, std::chrono::duration_cast<std::chrono::microseconds>(start - origin).count());
+        write_int<uint64_t>(out, result.duration.count());
+        out.flush();
+        ++entry_count;
+    }
+
+    auto Command_archive::replay(std::string_view args, double speed) -> Command_result
+    {
+        auto lock = std::unique_lock{ *mutex };
+
+        auto it = entries.find(args);
+        if (it == entries.end() || it->second.empty())
+            throw std::runtime_error(std::format("Command was not recorded: {0}", args));
+
+        auto result = it->second.front();
+        if (it->second.size() > 1) it->second.pop_front();
+        lock.unlock();
+
+        if (speed > 0)
+            std::this_thread::sleep_for(std::chrono::duration_cast<std::chrono::microseconds>(result.duration / speed));
+
+        return result;
+    }
+
+} // ns Conan
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <deque>
+#include "./command_runner.h"
+
+
+namespace Conan {
+
+    /**
+     * Archive of conan CLI invocations: command line (arguments only, without the executable), stdout,
+     * stderr, exit code and timing. Used to capture real sessions and to reproduce them byte for byte.
+     *
+     * File format: the magic line "CONAN-GUI-REC 1\n", followed by one record per invocation:
+     *   u32 length + bytes   arguments
+     *   u32 length + bytes   stdout
+     *   u32 length + bytes   stderr
+     *   i32                  exit code
+     *   u64                  start time, in microseconds since the start of the recording
+     *   u64                  duration, in microseconds
+     * All integers are little-endian.
+     */
+    class Command_archive {
+    public:
+
+        // Opens the archive for recording (truncating it) or for replaying.
+        static auto create(const std::string& filename) -> Command_archive;
+        static auto open(const std::string& filename) -> Command_archive;
+
+        Command_archive(Command_archive&&) = default;
+        Command_archive& operator = (Command_archive&&) = default;
+
+        void record(std::string_view args, const Command_result&, std::chrono::steady_clock::time_point start);
+
+        // Returns the next recorded result for the given arguments, waiting for its original duration
+        // divided by speed (speed 0 = no waiting). Repeated invocations are replayed in recording order;
+        // once exhausted, the last one is repeated. Throws if the arguments were never recorded.
+        auto replay(std::string_view args, double speed) -> Command_result;
+
+        auto size() const { return entry_count; }
+
+    private:
+
+        Command_archive() = default;
+
+        std::unique_ptr<std::mutex>                 mutex = std::make_unique<std::mutex>();
+        std::ofstream                               out;
+        std::chrono::steady_clock::time_point       origin = std::chrono::steady_clock::now();
+        std::map<std::string, std::deque<Command_result>, std::less<>> entries;
+        size_t                                      entry_count = 0;
+    };
+
+} // ns Conan
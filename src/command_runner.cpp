@@ -0,0 +1,235 @@
+#include <algorithm>
+#include <cstdio>
+#include <system_error>
+#include <format>
+#include "./command_runner.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <future>
+#include <vector>
+#else
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+extern char** environ;
+#endif
+
+
+namespace Conan {
+
+#ifdef _WIN32
+
+    // Owns a handle
+    struct Handle {
+        HANDLE h = nullptr;
+
+        Handle() = default;
+        explicit Handle(HANDLE h): h{h} {}
+        Handle(const Handle&) = delete;
+        auto operator = (const Handle&) -> Handle& = delete;
+        ~Handle() { close(); }
+
+        void close() { if (h && h != INVALID_HANDLE_VALUE) CloseHandle(h); h = nullptr; }
+        operator HANDLE () const { return h; }
+    };
+
+    [[noreturn]] static void throw_last_error()
+    {
+        throw std::system_error(static_cast<int>(GetLastError()), std::system_category());
+    }
+
+    auto run_command(const std::string& command_line, std::chrono::milliseconds timeout) -> Command_result
+    {
+        Command_result result;
+
+        auto start = std::chrono::steady_clock::now();
+        auto deadline = start + timeout;
+
+        // stdout and stderr through pipes, stdin from NUL. Only these handles are passed to the child (not all
+        // the inheritable ones), so that the commands run concurrently by other threads do not inherit the
+        // pipes (and keep them open after this command is done).
+        SECURITY_ATTRIBUTES inheritable{ sizeof(SECURITY_ATTRIBUTES), nullptr, TRUE };
+        Handle out_read, out_write, err_read, err_write;
+        if (!CreatePipe(&out_read.h, &out_write.h, &inheritable, 0) || !CreatePipe(&err_read.h, &err_write.h, &inheritable, 0))
+            throw_last_error();
+        SetHandleInformation(out_read, HANDLE_FLAG_INHERIT, 0);
+        SetHandleInformation(err_read, HANDLE_FLAG_INHERIT, 0);
+        Handle null_input{ CreateFileA("NUL", GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, &inheritable, OPEN_EXISTING, 0, nullptr) };
+        if (null_input == INVALID_HANDLE_VALUE) throw_last_error();
+
+        HANDLE inherited[] = { null_input, out_write, err_write };
+        SIZE_T size = 0;
+        InitializeProcThreadAttributeList(nullptr, 1, 0, &size);
+        std::vector<char> attribute_buffer(size);
+        auto attributes = reinterpret_cast<LPPROC_THREAD_ATTRIBUTE_LIST>(attribute_buffer.data());
+        if (!InitializeProcThreadAttributeList(attributes, 1, 0, &size)) throw_last_error();
+        UpdateProcThreadAttribute(attributes, 0, PROC_THREAD_ATTRIBUTE_HANDLE_LIST, inherited, sizeof(inherited), nullptr, nullptr);
+
+        STARTUPINFOEXA startup{};
+        startup.StartupInfo.cb = sizeof(startup);
+        startup.StartupInfo.dwFlags = STARTF_USESTDHANDLES;
+        startup.StartupInfo.hStdInput = null_input;
+        startup.StartupInfo.hStdOutput = out_write;
+        startup.StartupInfo.hStdError = err_write;
+        startup.lpAttributeList = attributes;
+
+        // The shell goes into a job (it is started suspended, so that whatever it starts is in the job too); the
+        // job is killed at the deadline, and whatever is left of it once the job handle is closed
+        Handle job{ CreateJobObjectA(nullptr, nullptr) };
+        if (!job) throw_last_error();
+        JOBOBJECT_EXTENDED_LIMIT_INFORMATION limits{};
+        limits.BasicLimitInformation.LimitFlags = JOB_OBJECT_LIMIT_KILL_ON_JOB_CLOSE;
+        SetInformationJobObject(job, JobObjectExtendedLimitInformation, &limits, sizeof(limits));
+
+        // (Like _popen(): through cmd.exe, which strips the outer quotes with /S)
+        auto shell_command = std::format("cmd.exe /S /C \"{0}\"", command_line);
+        PROCESS_INFORMATION process{};
+        auto created = CreateProcessA(nullptr, shell_command.data(), nullptr, nullptr, TRUE,
+            CREATE_SUSPENDED | CREATE_NO_WINDOW | EXTENDED_STARTUPINFO_PRESENT, nullptr, nullptr, &startup.StartupInfo, &process);
+        DeleteProcThreadAttributeList(attributes);
+        if (!created) throw_last_error();
+        Handle process_handle{ process.hProcess }, thread_handle{ process.hThread };
+        if (!AssignProcessToJobObject(job, process_handle)) {
+            TerminateProcess(process_handle, 1);
+            throw_last_error();
+        }
+        ResumeThread(thread_handle);
+        out_write.close();
+        err_write.close();
+        null_input.close();
+
+        // Anonymous pipes cannot be waited on: they are read by threads, until every process of the job that
+        // holds their write end has exited
+        auto drain = [](HANDLE pipe, std::string* target) {
+            char buffer[4096];
+            DWORD n = 0;
+            while (ReadFile(pipe, buffer, sizeof(buffer), &n, nullptr) && n > 0)
+                target->append(buffer, n);
+        };
+        auto out_reader = std::async(std::launch::async, drain, out_read.h, &result.output);
+        auto err_reader = std::async(std::launch::async, drain, err_read.h, &result.errors);
+        auto done = [&](std::future<void>& reader) {
+            return timeout.count() <= 0 || reader.wait_until(deadline) == std::future_status::ready;
+        };
+        if (!done(out_reader) || !done(err_reader)) {
+            TerminateJobObject(job, 1);
+            result.timed_out = true;
+        }
+        out_reader.get();
+        err_reader.get();
+
+        WaitForSingleObject(process_handle, INFINITE);
+        DWORD exit_code = 0;
+        GetExitCodeProcess(process_handle, &exit_code);
+        result.exit_code = result.timed_out ? -1 : static_cast<int>(exit_code);
+        result.duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+        if (result.timed_out)
+            result.errors += std::format("ERROR: timed out after {0} ms, killed\n", timeout.count());
+
+        return result;
+    }
+
+#else
+
+    // Close-on-exec, so that the commands run concurrently by other threads do not inherit the pipe (and keep
+    // it open after this command is done)
+    static bool make_pipe(int fds[2])
+    {
+#ifdef __linux__
+        return pipe2(fds, O_CLOEXEC) == 0;
+#else
+        if (pipe(fds) != 0) return false;
+        fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+        fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+        return true;
+#endif
+    }
+
+    auto run_command(const std::string& command_line, std::chrono::milliseconds timeout) -> Command_result
+    {
+        Command_result result;
+
+        auto start = std::chrono::steady_clock::now();
+        auto deadline = start + timeout;
+
+        // stdout and stderr through pipes; the shell gets its own process group, so that a kill at the
+        // deadline reaches whatever it started
+        int out_pipe[2], err_pipe[2];
+        if (!make_pipe(out_pipe)) throw std::system_error(errno, std::generic_category());
+        if (!make_pipe(err_pipe)) {
+            close(out_pipe[0]); close(out_pipe[1]);
+            throw std::system_error(errno, std::generic_category());
+        }
+
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_adddup2(&actions, out_pipe[1], 1);
+        posix_spawn_file_actions_adddup2(&actions, err_pipe[1], 2);
+        for (auto fd: { out_pipe[0], out_pipe[1], err_pipe[0], err_pipe[1] })
+            posix_spawn_file_actions_addclose(&actions, fd);
+        posix_spawnattr_t attributes;
+        posix_spawnattr_init(&attributes);
+        posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP);
+        posix_spawnattr_setpgroup(&attributes, 0);
+
+        pid_t pid = 0;
+        const char* argv[] = { "sh", "-c", command_line.c_str(), nullptr };
+        auto err = posix_spawn(&pid, "/bin/sh", &actions, &attributes, const_cast<char**>(argv), environ);
+        posix_spawn_file_actions_destroy(&actions);
+        posix_spawnattr_destroy(&attributes);
+        close(out_pipe[1]);
+        close(err_pipe[1]);
+        if (err != 0) {
+            close(out_pipe[0]); close(err_pipe[0]);
+            throw std::system_error(err, std::generic_category());
+        }
+
+        pollfd fds[] = { { out_pipe[0], POLLIN, 0 }, { err_pipe[0], POLLIN, 0 } };
+        std::string* targets[] = { &result.output, &result.errors };
+        char buffer[4096];
+        for (auto open = 2; open > 0;) {
+            auto wait_ms = -1;
+            if (timeout.count() > 0) {
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+                if (left <= 0) {
+                    kill(-pid, SIGKILL);
+                    result.timed_out = true;
+                    break;
+                }
+                wait_ms = static_cast<int>(std::min<int64_t>(left, 1000));
+            }
+            if (poll(fds, 2, wait_ms) < 0 && errno != EINTR) break;
+            for (auto i = 0; i < 2; i++) {
+                if (fds[i].fd < 0 || !(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+                auto n = read(fds[i].fd, buffer, sizeof(buffer));
+                if (n > 0)
+                    targets[i]->append(buffer, n);
+                else if (n == 0 || errno != EINTR) {
+                    close(fds[i].fd);
+                    fds[i].fd = -1;
+                    --open;
+                }
+            }
+        }
+        for (auto& fd: fds)
+            if (fd.fd >= 0) close(fd.fd);
+
+        int status = 0;
+        while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
+        result.exit_code = !result.timed_out && WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+        result.duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+        if (result.timed_out)
+            result.errors += std::format("ERROR: timed out after {0} ms, killed\n", timeout.count());
+
+        return result;
+    }
+
+#endif
+
+} // ns Conan
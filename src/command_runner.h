@@ -0,0 +1,22 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+
+
+namespace Conan {
+
+    struct Command_result {
+        std::string                 output;         // stdout
+        std::string                 errors;         // stderr
+        int                         exit_code = 0;
+        std::chrono::microseconds   duration{};
+        bool                        timed_out = false;  // killed at the deadline (exit_code is then -1)
+    };
+
+    // Runs a command line through the shell and collects its output, error output and exit code. If the
+    // command is still running after "timeout" (0 = no deadline), it is killed along with its children
+    // (its process group, or on Windows its job object).
+    auto run_command(const std::string& command_line, std::chrono::milliseconds timeout = {}) -> Command_result;
+
+} // ns Conan
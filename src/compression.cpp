@@ -0,0 +1,24 @@
+#include <stdexcept>
+#include <format>
+#include <zlib.h>
+#include "./compression.h"
+
+
+auto compress_text(std::string_view text) -> std::vector<uint8_t>
+{
+    std::vector<uint8_t> data(compressBound(static_cast<uLong>(text.size())));
+    auto size = static_cast<uLongf>(data.size());
+    auto err = compress2(data.data(), &size, reinterpret_cast<const Bytef*>(text.data()), static_cast<uLong>(text.size()), Z_DEFAULT_COMPRESSION);
+    if (err != Z_OK) throw std::runtime_error(std::format("zlib compress2() failed (code {0})", err));
+    data.resize(size);
+    return data;
+}
+
+auto decompress_text(const std::vector<uint8_t>& data, size_t size) -> std::string
+{
+    std::string text(size, '\0');
+    auto text_size = static_cast<uLongf>(size);
+    auto err = uncompress(reinterpret_cast<Bytef*>(text.data()), &text_size, data.data(), static_cast<uLong>(data.size()));
+    if (err != Z_OK || text_size != size) throw std::runtime_error(std::format("zlib uncompress() failed (code {0})", err));
+    return text;
+}
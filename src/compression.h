@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+// zlib compression of text blobs (e.g. conan output stored in the cache). Throws std::runtime_error on failure.
+auto compress_text(std::string_view text) -> std::vector<uint8_t>;
+
+// "size" is the size of the original text
+auto decompress_text(const std::vector<uint8_t>& data, size_t size) -> std::string;
@@ -0,0 +1,129 @@
+#include <cctype>
+#include <iostream>
+#include <map>
+#include <regex>
+#include <format>
+#include "./string_utils.h"
+#include "./conan_metadata.h"
+
+
+static const auto string_literal = std::regex(R"re("((?:[^"\\]|\\.)*)"|'((?:[^'\\]|\\.)*)')re");
+
+// The value of a class attribute of a conanfile, as "conan inspect" prints it: strings without their
+// quotes (adjacent literals concatenated), tuples and lists with single-quoted items, and dicts (options,
+// default_options) as indented "key: value" lines, by key, that start on the next line
+static auto attribute_value(std::string_view expression) -> std::string
+{
+    static const auto dict_entry = std::regex(
+        R"re(("(?:[^"\\]|\\.)*"|'(?:[^'\\]|\\.)*')\s*:\s*(\[[^\]]*\]|\([^)]*\)|"(?:[^"\\]|\\.)*"|'(?:[^'\\]|\\.)*'|[^,}]+))re");
+
+    auto text = std::string{ expression };
+    while (!text.empty() && std::isspace(static_cast<unsigned char>(text.back()))) text.pop_back();
+
+    if (!text.empty() && text.front() == '{') {
+        std::map<std::string, std::string> entries;
+        for (auto it = std::sregex_iterator(text.begin(), text.end(), dict_entry); it != std::sregex_iterator(); ++it) {
+            // (Lists of values keep their brackets, with single-quoted items)
+            auto value = attribute_value((*it)[2].str());
+            if (value.starts_with('(') && (*it)[2].str().starts_with('['))
+                value = '[' + value.substr(1, value.size() - 2) + ']';
+            entries[attribute_value((*it)[1].str())] = value;
+        }
+        std::string value;
+        for (auto& [key, entry]: entries)
+            value += std::format("\n    {0}: {1}", key, entry);
+        return value;
+    }
+
+    auto is_sequence = false;
+    if (!text.empty() && (text.front() == '(' || text.front() == '[')) {
+        // A parenthesized string (possibly spread over several literals) is not a tuple
+        is_sequence = text.find(',') != std::string::npos;
+        if (!is_sequence) text = text.substr(1, text.size() - 2);
+    }
+    else
+        is_sequence = std::regex_replace(text, string_literal, "").find(',') != std::string::npos;  // a, b
+
+    std::vector<std::string> literals;
+    for (auto it = std::sregex_iterator(text.begin(), text.end(), string_literal); it != std::sregex_iterator(); ++it)
+        literals.push_back((*it)[1].matched ? (*it)[1].str() : (*it)[2].str());
+    if (literals.empty()) return text;  // None, True, numbers...
+
+    if (!is_sequence) return join_strings(literals, "");
+    std::string value = "(";
+    for (auto& literal: literals)
+        value += std::format("{0}'{1}'", value.size() > 1 ? ", " : "", literal);
+    return value + ")";
+}
+
+auto conanfile_inspect_output(std::string_view conanfile) -> std::string
+{
+    static const auto attribute = std::regex(R"(^    (name|version|url|homepage|license|author|description|topics|provides|)"
+        R"(generators|exports|exports_sources|short_paths|apply_env|build_policy|revision_mode|settings|options|)"
+        R"(default_options|deprecated)\s*=\s*(.*)$)");
+
+    std::string output;
+    std::string pending_name, pending_value;
+    auto depth = 0;
+
+    // Values can span several lines, as long as brackets are open
+    for_each_line(conanfile, [&](std::string_view line) {
+        std::string input{ line };
+        if (!pending_name.empty()) {
+            pending_value += ' ' + std::regex_replace(input, std::regex(R"(^\s+)"), "");
+        }
+        else if (std::smatch m; std::regex_match(input, m, attribute)) {
+            pending_name = m[1];
+            pending_value = m[2];
+            depth = 0;
+        }
+        else
+            return;
+        for (auto ch: line) depth += ch == '(' || ch == '[' || ch == '{' ? 1 : ch == ')' || ch == ']' || ch == '}' ? -1 : 0;
+        if (depth <= 0) {
+            auto value = attribute_value(pending_value);
+            output += std::format("{0}:{1}{2}\n", pending_name, value.starts_with('\n') ? "" : " ", value);
+            pending_name.clear();
+        }
+    });
+
+    return output;
+}
+
+auto parse_inspect_output(std::string_view output) -> Package_info
+{
+    // auto re = std::regex("^[ \t]+([^:]+):[ \t]*(.*)$");
+    auto re = std::regex("^([^:]+):[ \t]*(.*)$");
+
+    Package_info info;
+    std::string* value = nullptr;   // of the last attribute, which the indented lines that follow continue (options...)
+
+    for_each_line(output, [&](std::string_view line) {
+        if (!line.empty() && (line.front() == ' ' || line.front() == '\t')) {
+            if (value) *value += std::format("{0}{1}", value->empty() ? "" : "\n", line.substr(line.find_first_not_of(" \t")));
+            return;
+        }
+        std::string input{ line };
+        std::smatch m;
+        if (std::regex_match(input, m, re)) {
+            value = nullptr;
+            // if (m[1] == "Description") info.description = m[2];
+            if      (m[1] == "description") info.description = m[2];
+            else if (m[1] == "license"    ) info.license     = m[2];
+            else if (m[1] == "provides"   ) info.provides    = m[2];
+            else if (m[1] == "author"     ) info.author      = m[2];
+            else if (m[1] == "topics"     ) info.topics      = parseTagList(m[2].str());
+            // (The name and version are those of the package key, and unset attributes are left out)
+            else if (m[1] != "name" && m[1] != "version" && m[2] != "None") {
+                value = &info.attributes[m[1]];
+                *value = m[2];
+            }
+        }
+        else {
+            std::cerr << "***FAILED to parse info line \"" << input << "\"" << std::endl;
+        }
+    });
+    std::erase_if(info.attributes, [](const auto& attribute) { return attribute.second.empty(); });
+
+    return info;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include "./types.h"
+
+
+// The attributes of a conanfile.py that "conan inspect" shows, in its format (so that recipes read directly,
+// e.g. over the REST API or from the local cache, are handled like inspect output)
+auto conanfile_inspect_output(std::string_view conanfile) -> std::string;
+
+// Package info from the output of "conan inspect" (the attributes without a Package_info member go to attributes)
+auto parse_inspect_output(std::string_view output) -> Package_info;
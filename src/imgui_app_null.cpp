@@ -0,0 +1,353 @@
+// Headless implementation of imgui_app.h: no window, no GPU, no rendering backend.
+//
+// Frames are generated (ImGui::Render() is called, so draw lists are fully built) but never presented.
+// The interaction is driven by a script, and the CPU time, vertex/index counts and allocations of every
+// frame are reported, so that the cost of drawing large trees can be measured in CI or on the build farm.
+//
+// Environment variables:
+//   CONAN_GUI_SCRIPT   script file to run (default: open every letter, then scroll down and back up)
+//   CONAN_GUI_REPORT   file to write the per-frame report to, as CSV (default: stdout)
+//
+// Script commands (one per line, '#' starts a comment):
+//   frames N           run N frames without input
+//   wait MS            keep running frames (at about 60 per second) for MS milliseconds, e.g. for
+//                      background fetches to complete
+//   open PATH          open a tree node (without clicking it); PATH is "Window/label/label/..."
+//   close PATH         close a tree node
+//   click PATH         click the item identified by PATH (it must have been visible in the previous frame)
+//   click_at X Y       click at a screen position
+//   wheel DY           turn the mouse wheel over the "Conan" window (negative = scroll down)
+//   type TEXT          type text into the focused widget
+//   mark LABEL         label the following frames in the report
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <format>
+#include "imgui.h"
+#include "imgui_internal.h"
+#include "./imgui_app.h"
+
+
+// Allocation counting ------------------------------------------------------
+
+// Counted per thread, so that the numbers reported for a frame only reflect the UI thread
+static thread_local size_t t_alloc_count = 0;
+static thread_local size_t t_alloc_bytes = 0;
+
+void* operator new(size_t size)
+{
+    ++t_alloc_count;
+    t_alloc_bytes += size;
+    if (auto ptr = std::malloc(size ? size : 1)) return ptr;
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+
+static void* imgui_alloc(size_t size, void*) { ++t_alloc_count; t_alloc_bytes += size; return std::malloc(size); }
+static void imgui_free(void* ptr, void*) { std::free(ptr); }
+
+
+// Item registry (through the ImGui test engine hooks) ------------------------
+
+// Bounding boxes of the items submitted during the previous frame, by ID
+static std::unordered_map<ImGuiID, ImRect> g_item_rects, g_item_rects_building;
+
+void ImGuiTestEngineHook_ItemAdd(ImGuiContext*, const ImRect& bb, ImGuiID id) { g_item_rects_building[id] = bb; }
+void ImGuiTestEngineHook_ItemInfo(ImGuiContext*, ImGuiID, const char*, ImGuiItemStatusFlags) {}
+void ImGuiTestEngineHook_IdInfo(ImGuiContext*, ImGuiDataType, ImGuiID, const void*) {}
+void ImGuiTestEngineHook_IdInfo(ImGuiContext*, ImGuiDataType, ImGuiID, const void*, const void*) {}
+void ImGuiTestEngineHook_Log(ImGuiContext*, const char*, ...) {}
+
+// Computes the ID that ImGui assigns to an item, given its path: window name, then labels of the ID stack
+static auto id_from_path(std::string_view path) -> ImGuiID
+{
+    ImGuiID id = 0;
+    for (size_t pos = 0; pos <= path.size();) {
+        auto slash = std::min(path.find('/', pos), path.size());
+        auto label = path.substr(pos, slash - pos);
+        id = label.empty() ? ImHashStr("", 0, id) : ImHashStr(label.data(), label.size(), id);
+        pos = slash + 1;
+    }
+    return id;
+}
+
+static auto window_name(std::string_view path) -> std::string
+{
+    return std::string{ path.substr(0, path.find('/')) };
+}
+
+
+// Script ---------------------------------------------------------------------
+
+struct Command {
+    std::string verb;
+    std::string arg;
+};
+
+static const char* default_script = R"(
+    frames 3
+    open Conan/A
+    open Conan/B
+    open Conan/C
+    open Conan/L
+    open Conan/O
+    wait 500
+    mark scroll
+    wheel -5
+    frames 10
+    wheel -5
+    frames 10
+    wheel 10
+    frames 10
+)";
+
+struct Frame_stats {
+    std::string label;
+    double      cpu_us;
+    int         vertices;
+    int         indices;
+    int         draw_cmds;
+    size_t      allocs;
+    size_t      alloc_bytes;
+};
+
+static std::vector<Command>     g_script;
+static size_t                   g_next_command = 0;
+static int                      g_idle_frames = 0;      // remaining frames of a "frames" command
+static std::chrono::steady_clock::time_point g_wait_until;  // end of a "wait" command
+static std::string              g_label = "startup";
+static bool                     g_release_mouse = false;
+static std::vector<Frame_stats> g_frames;
+
+static std::chrono::steady_clock::time_point g_frame_start;
+static size_t g_frame_allocs, g_frame_alloc_bytes;
+
+static void load_script()
+{
+    std::string text = default_script;
+    if (auto filename = std::getenv("CONAN_GUI_SCRIPT")) {
+        std::ifstream is{ filename };
+        if (!is) throw std::runtime_error(std::format("Unable to open script file \"{0}\"", filename));
+        text.assign(std::istreambuf_iterator<char>{ is }, {});
+    }
+
+    std::istringstream is{ text };
+    for (std::string line; std::getline(is, line);) {
+        line.erase(std::find(line.begin(), line.end(), '#'), line.end());
+        auto first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos) continue;
+        auto space = line.find_first_of(" \t", first);
+        auto arg_start = line.find_first_not_of(" \t", space);
+        auto last = line.find_last_not_of(" \t\r");
+        g_script.push_back({
+            line.substr(first, space - first),
+            arg_start == std::string::npos ? "" : line.substr(arg_start, last + 1 - arg_start)
+        });
+    }
+}
+
+static void set_open(const std::string& path, bool open)
+{
+    auto window = ImGui::FindWindowByName(window_name(path).c_str());
+    if (!window) {
+        std::cerr << std::format("Script: no window for path \"{0}\"", path) << std::endl;
+        return;
+    }
+    window->StateStorage.SetInt(id_from_path(path), open ? 1 : 0);
+}
+
+static void click_at(float x, float y)
+{
+    auto& io = ImGui::GetIO();
+    io.MousePos = { x, y };
+    io.MouseDown[0] = true;
+    g_release_mouse = true;
+}
+
+static bool waiting()
+{
+    return std::chrono::steady_clock::now() < g_wait_until;
+}
+
+// Still executing a "frames" or "wait" command ?
+static bool busy()
+{
+    return g_idle_frames > 0 || waiting();
+}
+
+// Feeds the script into the input state of the coming frame
+static void run_script()
+{
+    auto& io = ImGui::GetIO();
+
+    io.MouseWheel = 0;
+    if (g_release_mouse) {
+        io.MouseDown[0] = false;
+        g_release_mouse = false;
+        return; // let the click complete before anything else happens
+    }
+
+    while (!busy() && g_next_command < g_script.size()) {
+        auto& [verb, arg] = g_script[g_next_command++];
+        if (verb == "frames")
+            g_idle_frames = std::max(1, std::atoi(arg.c_str()));
+        else if (verb == "wait")
+            g_wait_until = std::chrono::steady_clock::now() + std::chrono::milliseconds{ std::atoi(arg.c_str()) };
+        else if (verb == "open" || verb == "close")
+            set_open(arg, verb == "open");
+        else if (verb == "mark")
+            g_label = arg;
+        else if (verb == "type") {
+            for (auto ch : arg) io.AddInputCharacter(ch);
+            g_idle_frames = 1;
+        }
+        else if (verb == "wheel") {
+            if (auto window = ImGui::FindWindowByName("Conan"))
+                io.MousePos = window->Rect().GetCenter();
+            io.MouseWheel = static_cast<float>(std::atof(arg.c_str()));
+            g_idle_frames = 1;
+        }
+        else if (verb == "click_at") {
+            float x = 0, y = 0;
+            std::istringstream{ arg } >> x >> y;
+            click_at(x, y);
+            g_idle_frames = 1;
+        }
+        else if (verb == "click") {
+            auto it = g_item_rects.find(id_from_path(arg));
+            if (it == g_item_rects.end())
+                std::cerr << std::format("Script: item \"{0}\" was not visible in the previous frame", arg) << std::endl;
+            else {
+                auto center = it->second.GetCenter();
+                click_at(center.x, center.y);
+                g_idle_frames = 1;
+            }
+        }
+        else
+            std::cerr << std::format("Script: unknown command \"{0}\"", verb) << std::endl;
+    }
+}
+
+static void write_report()
+{
+    std::ofstream file;
+    auto filename = std::getenv("CONAN_GUI_REPORT");
+    if (filename) file.open(filename);
+    std::ostream& os = filename ? file : std::cout;
+
+    os << "frame,label,cpu_us,vertices,indices,draw_cmds,allocs,alloc_bytes\n";
+    for (auto i = 0U; i < g_frames.size(); i++) {
+        auto& f = g_frames[i];
+        os << std::format("{0},{1},{2:.1f},{3},{4},{5},{6},{7}\n", i, f.label, f.cpu_us, f.vertices, f.indices, f.draw_cmds, f.allocs, f.alloc_bytes);
+    }
+
+    if (g_frames.empty()) return;
+    std::vector<double> times;
+    for (auto& f : g_frames) times.push_back(f.cpu_us);
+    std::sort(times.begin(), times.end());
+    auto percentile = [&](double p) { return times[std::min(times.size() - 1, static_cast<size_t>(p * times.size()))]; };
+    std::cerr << std::format("{0} frames; CPU time per frame (us): median {1:.1f}, p95 {2:.1f}, max {3:.1f}",
+        times.size(), percentile(0.5), percentile(0.95), times.back()) << std::endl;
+}
+
+
+// imgui_app.h ------------------------------------------------------------------
+
+void imgui_init(const char*)
+{
+    ImGui::SetAllocatorFunctions(imgui_alloc, imgui_free);
+    ImGui::CreateContext();
+
+    auto& io = ImGui::GetIO();
+    io.DisplaySize = { 1280, 800 };
+    io.IniFilename = nullptr;
+    io.DeltaTime = 1.0f / 60.0f;
+
+    // The font atlas must be built, but there is nothing to upload it to
+    unsigned char* pixels;
+    int width, height;
+    io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+    io.Fonts->SetTexID(nullptr);
+
+    ImGui::StyleColorsDark();
+
+    GImGui->TestEngineHookItems = true;
+
+    load_script();
+}
+
+bool imgui_continue()
+{
+    if (!busy() && g_next_command >= g_script.size() && !g_release_mouse) {
+        write_report();
+        return false;
+    }
+    return true;
+}
+
+void imgui_new_frame()
+{
+    if (waiting()) std::this_thread::sleep_for(std::chrono::milliseconds{ 16 });
+
+    run_script();
+    if (g_idle_frames > 0) --g_idle_frames;
+
+    g_frame_allocs = t_alloc_count;
+    g_frame_alloc_bytes = t_alloc_bytes;
+    g_frame_start = std::chrono::steady_clock::now();
+
+    g_item_rects_building.clear();
+    ImGui::NewFrame();
+
+    // The application window would otherwise be sized to its content of the first frame, leaving items that
+    // appear later (like the Re-scan buttons after the summaries) clipped and out of reach of "click"
+    ImGui::SetNextWindowPos({ 0, 0 }, ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowSize(ImGui::GetIO().DisplaySize, ImGuiCond_FirstUseEver);
+}
+
+void imgui_frame_done()
+{
+    ImGui::Render();
+
+    auto elapsed = std::chrono::steady_clock::now() - g_frame_start;
+    auto allocs = t_alloc_count - g_frame_allocs;
+    auto alloc_bytes = t_alloc_bytes - g_frame_alloc_bytes;
+    auto draw_data = ImGui::GetDrawData();
+
+    Frame_stats stats{
+        .label       = g_label,
+        .cpu_us      = std::chrono::duration<double, std::micro>(elapsed).count(),
+        .vertices    = draw_data->TotalVtxCount,
+        .indices     = draw_data->TotalIdxCount,
+        .draw_cmds   = 0,
+        .allocs      = allocs,
+        .alloc_bytes = alloc_bytes,
+    };
+    for (auto i = 0; i < draw_data->CmdListsCount; i++)
+        stats.draw_cmds += draw_data->CmdLists[i]->CmdBuffer.Size;
+    g_frames.push_back(std::move(stats));
+
+    std::swap(g_item_rects, g_item_rects_building);
+}
+
+void imgui_cleanup()
+{
+    ImGui::DestroyContext();
+}
+
+auto imgui_default_font_size() -> float
+{
+    return 13.0f;
+}
@@ -0,0 +1,191 @@
+#include <iostream>
+#include <algorithm>
+#include <format>
+#include <imgui.h>
+#include "./cache_writer.h"
+#include "./repo_reader.h"
+#include "./job_queue.h"
+#include "./gui_elements.h"
+#include "./info_crawler.h"
+
+
+Info_crawler::Info_crawler(Conan::Repository_reader& rr, Crawler_options options_):
+    repo_reader{rr},
+    options{std::move(options_)},
+    limiter{options.rate, 1}
+{
+    thread = std::thread{[this]() {
+        try {
+            run();
+        }
+        catch (const std::exception& e) {
+            std::cerr << "***Info crawler stopped: " << e.what() << std::endl;
+        }
+    }};
+}
+
+Info_crawler::~Info_crawler()
+{
+    {
+        auto lock = std::unique_lock{mutex};
+        term_flag = true;
+    }
+    cond_var.notify_all();
+    thread.join();
+}
+
+void Info_crawler::set_enabled(bool enabled)
+{
+    auto lock = std::unique_lock{mutex};
+    state.enabled = enabled;
+    cond_var.notify_all();
+}
+
+auto Info_crawler::progress() -> Progress
+{
+    auto lock = std::unique_lock{mutex};
+    return state;
+}
+
+void Info_crawler::draw_status()
+{
+    static const char* status_names[] = { "starting", "running", "waiting for user requests", "idle", "paused" };
+
+    auto progress = this->progress();
+
+    gui::FormattedText("Info crawler: {0} done, {1} failed, {2} to go ({3})",
+        progress.done, progress.failed, progress.remaining, status_names[static_cast<int>(progress.status)]);
+    ImGui::SameLine();
+    if (ImGui::SmallButton(progress.enabled ? "Pause" : "Resume"))
+        set_enabled(!progress.enabled);
+    if (progress.status == Status::running) {
+        ImGui::SameLine();
+        ImGui::TextDisabled("%s", progress.current.c_str());
+    }
+}
+
+bool Info_crawler::wait_until(Clock::time_point time)
+{
+    auto lock = std::unique_lock{mutex};
+    cond_var.wait_until(lock, time, [this]() { return term_flag; });
+    return !term_flag;
+}
+
+void Info_crawler::set_status(Status status, std::string current)
+{
+    auto lock = std::unique_lock{mutex};
+    state.status = status;
+    state.current = std::move(current);
+}
+
+auto Info_crawler::remote_limiter(const std::string& remote) -> Rate_limiter&
+{
+    auto& limiter = remote_limiters[remote];
+    if (!limiter) limiter = std::make_unique<Rate_limiter>(options.remote_rate, 1);
+    return *limiter;
+}
+
+void Info_crawler::run()
+{
+    Cache_db db;
+
+    auto saved = db.get_crawler_state();
+    {
+        auto lock = std::unique_lock{mutex};
+        state.enabled = saved.enabled;
+        state.done = saved.done;
+        state.failed = saved.failed;
+    }
+
+    auto last_refill = Clock::time_point{};
+    std::vector<Package_list_entry> batch;
+
+    for (;;) {
+
+        // Paused (persistently) by the user ?
+        {
+            auto lock = std::unique_lock{mutex};
+            if (term_flag) return;
+            if (state.enabled != saved.enabled) {
+                saved.enabled = state.enabled;
+                Cache_writer::instance().write([saved](Cache_db& db) { db.save_crawler_state(saved); });
+            }
+            if (!state.enabled) {
+                state.status = Status::paused;
+                cond_var.wait(lock, [this]() { return term_flag || state.enabled; });
+                continue;
+            }
+        }
+
+        // User-requested inspects take precedence
+        auto& jobs = Job_queue::instance();
+        if (jobs.pending(Job_queue::Priority::high) + jobs.pending(Job_queue::Priority::normal) > 0) {
+            set_status(Status::waiting_for_user);
+            if (!wait_until(Clock::now() + std::chrono::milliseconds{ 250 })) return;
+            continue;
+        }
+
+        if (batch.empty()) {
+            batch = db.get_crawl_batch(options.batch_size, options.max_attempts);
+            if (batch.empty()) {
+                // Look for new packages (e.g. from scans) from time to time
+                if (Clock::now() - last_refill >= options.refill_interval) {
+                    Cache_writer::instance().write([](Cache_db& db) { return db.refill_crawl_queue(); }).get();
+                    last_refill = Clock::now();
+                    auto remaining = db.count_crawl_remaining(options.max_attempts);
+                    auto lock = std::unique_lock{mutex};
+                    state.remaining = remaining;
+                    continue;
+                }
+                set_status(Status::idle);
+                if (!wait_until(Clock::now() + std::chrono::seconds{ 10 })) return;
+                continue;
+            }
+            auto remaining = db.count_crawl_remaining(options.max_attempts);
+            auto lock = std::unique_lock{mutex};
+            state.remaining = remaining;
+        }
+
+        // Next package whose remote is below its rate limit, so that one remote does not hold up the others
+        auto package = batch.end();
+        auto ready_at = Clock::time_point::max();
+        for (auto it = batch.begin(); it != batch.end(); ++it) {
+            Clock::time_point remote_ready_at;
+            if (remote_limiter(it->remote).try_acquire(1, remote_ready_at)) {
+                package = it;
+                break;
+            }
+            ready_at = std::min(ready_at, remote_ready_at);
+        }
+        if (package == batch.end()) {
+            if (!wait_until(ready_at)) return;
+            continue;
+        }
+        for (Clock::time_point global_ready_at; !limiter.try_acquire(1, global_ready_at);)
+            if (!wait_until(global_ready_at)) return;
+
+        auto key = static_cast<Package_key>(*package);
+        auto pkg_id = package->id;
+        batch.erase(package);
+
+        set_status(Status::running, std::format("{0}/{1}@{2}/{3} ({4})",
+            key.reference.package, key.reference.version, key.reference.user, key.reference.channel, key.remote));
+        auto info = repo_reader.try_get_info(key);
+
+        ++(info ? saved.done : saved.failed);
+        Cache_writer::instance().write([&](Cache_db& db) {
+            if (info) {
+                db.upsert_package_info(pkg_id, *info);
+                db.remove_from_crawl_queue(pkg_id);
+            }
+            else
+                db.mark_crawl_failed(pkg_id);
+            db.save_crawler_state(saved);
+        }).get();
+
+        auto lock = std::unique_lock{mutex};
+        state.done = saved.done;
+        state.failed = saved.failed;
+        state.remaining = std::max<int64_t>(0, state.remaining - 1);
+    }
+}
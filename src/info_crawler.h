@@ -0,0 +1,68 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "./rate_limiter.h"
+#include "./cache_db.h"
+
+
+namespace Conan { class Repository_reader; }
+
+struct Crawler_options {
+    double                  rate = 1;               // inspects per second, over all remotes
+    double                  remote_rate = 0.5;      // inspects per second on any one remote
+    int64_t                 max_attempts = 3;       // packages that failed that many times are left alone
+    size_t                  batch_size = 20;
+    std::chrono::minutes    refill_interval{ 5 };   // how often to look for new packages once the queue is exhausted
+};
+
+// Fills in the info of the packages that nobody has opened yet, newest versions first, at a low rate and
+// only while no user-requested inspects are queued. The queue and the counters are kept in the database,
+// so the crawl resumes where it left off after a restart.
+class Info_crawler {
+public:
+    enum class Status { starting, running, waiting_for_user, idle, paused };
+
+    struct Progress {
+        Status      status = Status::starting;
+        bool        enabled = true;
+        int64_t     done = 0;
+        int64_t     failed = 0;
+        int64_t     remaining = 0;
+        std::string current;        // package being inspected
+    };
+
+    explicit Info_crawler(Conan::Repository_reader&, Crawler_options = {});
+    ~Info_crawler();
+
+    void set_enabled(bool);
+    auto progress() -> Progress;
+
+    void draw_status();
+
+private:
+    using Clock = Rate_limiter::Clock;
+
+    void run();
+    bool wait_until(Clock::time_point); // false if the crawler is being stopped
+    void set_status(Status, std::string current = {});
+    auto remote_limiter(const std::string& remote) -> Rate_limiter&;
+
+    Conan::Repository_reader&   repo_reader;
+    Crawler_options             options;
+
+    std::mutex                  mutex;
+    std::condition_variable     cond_var;
+    Progress                    state;
+    bool                        term_flag = false;
+
+    Rate_limiter                limiter;
+    std::map<std::string, std::unique_ptr<Rate_limiter>> remote_limiters;  // crawler thread only
+
+    std::thread                 thread;
+};
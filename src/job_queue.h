@@ -1,63 +1,117 @@
 #pragma once
 
+#include <array>
 #include <functional>
 #include <thread>
 #include <mutex>
+#include <queue>
+#include <condition_variable>
+#include "./rate_limiter.h"
 
 
 class Job_queue {
 public:
     using Job = std::function<void(void)>;
 
-    static auto& instance() { 
-        static Job_queue _instance; return _instance; 
+    // Jobs are executed by priority, then in order of submission
+    enum class Priority { high, normal, low };
+
+    static auto& instance() {
+        static Job_queue _instance; return _instance;
     }
 
     ~Job_queue() {
-        term_flag = true;
+        {
+            auto lock = std::unique_lock{mutex};
+            term_flag = true;
+        }
         if (worker.joinable()) {
             cond_var.notify_one();
             worker.join();
         }
     }
 
-    void queue_job(Job&& job) {
+    // The cost of a job is the number of rate limiter tokens it takes (e.g. the number of requests in a batch)
+    void queue_job(Job&& job, Priority priority = Priority::normal, double cost = 1) {
         auto lock = std::unique_lock{mutex};
-        jobs.push(std::move(job));
+        queues[index(priority)].push({ std::move(job), cost });
         lock.unlock();
-        if (!worker.joinable()) 
+        if (!worker.joinable())
             worker = std::thread{[this]() { execute_jobs(); }};
         cond_var.notify_one();
     }
 
+    // Limits the rate at which the jobs of a priority are started (jobs per second, or cost units per second)
+    void set_rate_limit(Priority priority, double rate, double burst) {
+        limiters[index(priority)].configure(rate, burst);
+        cond_var.notify_one();
+    }
+
+    // Discards the jobs that have not started yet, and waits for the running one (if any) to complete
+    void cancel_pending() {
+        auto lock = std::unique_lock{mutex};
+        for (auto& jobs : queues) jobs = {};
+        idle_cv.wait(lock, [this]() { return !running; });
+    }
+
+    auto pending(Priority priority) -> size_t {
+        auto lock = std::unique_lock{mutex};
+        return queues[index(priority)].size();
+    }
+
 private:
 
+    struct Entry {
+        Job     job;
+        double  cost;
+    };
+
+    static auto index(Priority priority) -> size_t { return static_cast<size_t>(priority); }
+
     void execute_jobs() {
 
         for (Job job; (job = std::move(get_next_job()));) {
             job();
+            auto lock = std::unique_lock{mutex};
+            running = false;
+            idle_cv.notify_all();
         }
     }
 
     auto get_next_job() -> Job {
-        
+
         auto lock = std::unique_lock{ mutex };
-        cond_var.wait(lock, [this]() { 
-            return term_flag || !jobs.empty(); });
-        if (term_flag) {
-            lock.unlock();
-            return Job{};        
+        for (;;) {
+            if (term_flag) return Job{};
+
+            // Highest priority first; a rate-limited priority does not hold up the lower ones
+            auto wake_at = Rate_limiter::Clock::time_point::max();
+            for (auto i = 0U; i < queues.size(); i++) {
+                auto& jobs = queues[i];
+                if (jobs.empty()) continue;
+                Rate_limiter::Clock::time_point ready_at;
+                if (limiters[i].try_acquire(jobs.front().cost, ready_at)) {
+                    auto job = std::move(jobs.front().job);
+                    jobs.pop();
+                    running = true;
+                    return job;
+                }
+                wake_at = std::min(wake_at, ready_at);
+            }
+
+            if (wake_at == Rate_limiter::Clock::time_point::max())
+                cond_var.wait(lock);
+            else
+                cond_var.wait_until(lock, wake_at);
         }
-        // auto&& job = std::move(jobs.front());
-        auto job = jobs.front();
-        jobs.pop();
-        lock.unlock();
-        return job;
     }
 
     std::mutex              mutex;
-    std::queue<Job>         jobs;
+    std::array<std::queue<Entry>, 3> queues;
+    std::array<Rate_limiter, 3> limiters;
     std::thread             worker;
     std::condition_variable cond_var;
+    std::condition_variable idle_cv;
+    bool                    running = false;
     bool                    term_flag = false;
-};
\ No newline at end of file
+};
@@ -0,0 +1,414 @@
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <ctime>
+#include <fstream>
+#include <future>
+#include <map>
+#include <sstream>
+#include <tuple>
+#include <format>
+#include <imgui.h>
+#include <sqlite3.h>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+#include "./cache_writer.h"
+#include "./conan_metadata.h"
+#include "./gui_elements.h"
+#include "./local_cache_indexer.h"
+
+
+namespace fs = std::filesystem;
+
+
+auto Local_cache_root::detect(fs::path path) -> Local_cache_root
+{
+    auto layout = fs::exists(path / "cache.sqlite3") ? Layout::conan2 : Layout::conan1;
+    return { std::move(path), layout };
+}
+
+// Sub-folders of a folder, none if it cannot be read
+static auto subfolders(const fs::path& folder) -> std::vector<fs::path>
+{
+    std::vector<fs::path> list;
+    std::error_code ec;
+    for (auto it = fs::directory_iterator(folder, fs::directory_options::skip_permission_denied, ec); !ec && it != fs::directory_iterator(); it.increment(ec))
+        if (it->is_directory(ec)) list.push_back(it->path());
+    return list;
+}
+
+static auto read_file(const fs::path& path) -> std::optional<std::string>
+{
+    std::ifstream is{ path, std::ios::binary };
+    if (!is) return {};
+    std::ostringstream contents;
+    contents << is.rdbuf();
+    return contents.str();
+}
+
+static auto format_utc(std::time_t time) -> std::string
+{
+    std::tm tm{};
+#ifdef _WIN32
+    gmtime_s(&tm, &time);
+#else
+    gmtime_r(&time, &tm);
+#endif
+    char text[32];
+    std::strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", &tm);
+    return text;
+}
+
+// Folder names of Conan 1 stand for an empty user or channel with "_"
+static auto from_folder(const fs::path& folder) -> std::string
+{
+    auto name = folder.filename().string();
+    return name == "_" ? std::string{} : name;
+}
+
+// Runs fn(i) for i in [0, count) on a few threads
+template <typename Fn>
+static void parallel_for(size_t count, unsigned threads, Fn fn)
+{
+    std::atomic<size_t> next = 0;
+    std::vector<std::future<void>> workers;
+    for (auto i = 0U; i < std::min<size_t>(std::max(1U, threads), count); i++) {
+        workers.push_back(std::async(std::launch::async, [&]() {
+            for (size_t j; (j = next++) < count;) fn(j);
+        }));
+    }
+    for (auto& worker: workers) worker.get();
+}
+
+// Metadata from the exported conanfile.py, export time (first line of the manifest: a Unix time)
+static auto read_recipe_info(const fs::path& export_folder) -> std::optional<Package_info>
+{
+    auto conanfile = read_file(export_folder / "conanfile.py");
+    if (!conanfile) return {};
+
+    auto info = parse_inspect_output(conanfile_inspect_output(*conanfile));
+    if (auto manifest = read_file(export_folder / "conanmanifest.txt")) {
+        auto timestamp = std::atoll(manifest->c_str());
+        if (timestamp > 0) info.creation_date = format_utc(static_cast<std::time_t>(timestamp));
+    }
+    return info;
+}
+
+Local_cache_indexer::Local_cache_indexer(Local_cache_options options_):
+    options{std::move(options_)}
+{
+    thread = std::thread{[this]() { run(); }};
+}
+
+Local_cache_indexer::~Local_cache_indexer()
+{
+    {
+        auto lock = std::unique_lock{mutex};
+        term_flag = true;
+    }
+    cond_var.notify_all();
+    thread.join();
+}
+
+auto Local_cache_indexer::default_roots() -> std::vector<Local_cache_root>
+{
+    auto env_path = [](const char* name) -> fs::path {
+        auto value = getenv(name);
+        return value ? fs::path{ value } : fs::path{};
+    };
+
+    auto home = env_path("HOME");
+    if (home.empty()) home = env_path("USERPROFILE");
+
+    auto conan1_home = env_path("CONAN_USER_HOME");
+    if (conan1_home.empty()) conan1_home = home;
+    auto conan2_home = env_path("CONAN_HOME");
+    if (conan2_home.empty()) conan2_home = home / ".conan2";
+
+    std::vector<Local_cache_root> roots;
+    std::error_code ec;
+    for (auto path: { conan1_home / ".conan" / "data", conan2_home / "p" })
+        if (fs::is_directory(path, ec)) roots.push_back(Local_cache_root::detect(path));
+    return roots;
+}
+
+auto Local_cache_indexer::status() -> Status
+{
+    auto lock = std::unique_lock{mutex};
+    return current_status;
+}
+
+void Local_cache_indexer::draw_status()
+{
+    static const char* state_names[] = { "indexing", "watching", "idle", "failed" };
+
+    auto status = this->status();
+    gui::FormattedText("Local cache: {0} recipes, {1} binary packages ({2}, indexed in {3} ms, {4} updates)",
+        status.recipes, status.binaries, state_names[static_cast<int>(status.state)], status.index_duration.count(), status.updates);
+    if (!status.error.empty()) {
+        ImGui::SameLine();
+        ImGui::TextDisabled("%s", status.error.c_str());
+    }
+}
+
+bool Local_cache_indexer::stopping()
+{
+    auto lock = std::unique_lock{mutex};
+    return term_flag;
+}
+
+void Local_cache_indexer::run()
+{
+    try {
+        index_all();
+        if (options.watch) {
+            {
+                auto lock = std::unique_lock{mutex};
+                current_status.state = State::watching;
+            }
+            watch();
+        }
+        auto lock = std::unique_lock{mutex};
+        current_status.state = State::idle;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "***Local cache indexer stopped: " << e.what() << std::endl;
+        auto lock = std::unique_lock{mutex};
+        current_status.state = State::failed;
+        current_status.error = e.what();
+    }
+}
+
+auto Local_cache_indexer::read_conan1_cache(const Local_cache_root& root) -> std::vector<Recipe>
+{
+    // data/NAME/VERSION/USER/CHANNEL, with export/ (the recipe) and package/ID/ (the binaries)
+    auto names = subfolders(root.path);
+    std::vector<std::vector<Recipe>> found(names.size());
+
+    parallel_for(names.size(), options.threads, [&](size_t i) {
+        for (auto& version: subfolders(names[i]))
+            for (auto& user: subfolders(version))
+                for (auto& channel: subfolders(user)) {
+                    auto info = read_recipe_info(channel / "export");
+                    if (!info) continue;
+                    Recipe recipe{ { names[i].filename().string(), from_folder(user), from_folder(channel), version.filename().string() }, std::move(*info) };
+                    std::error_code ec;
+                    for (auto& package: subfolders(channel / "package"))
+                        if (fs::exists(package / "conaninfo.txt", ec)) ++recipe.binaries;
+                    found[i].push_back(std::move(recipe));
+                }
+    });
+
+    std::vector<Recipe> recipes;
+    for (auto& list: found) recipes.insert(recipes.end(), std::make_move_iterator(list.begin()), std::make_move_iterator(list.end()));
+    return recipes;
+}
+
+auto Local_cache_indexer::read_conan2_cache(const Local_cache_root& root) -> std::vector<Recipe>
+{
+    // The folders of the recipes (latest revision) and the number of binaries come from the cache database
+    struct Entry {
+        std::string reference;
+        fs::path    folder;
+        int64_t     binaries = 0;
+    };
+    std::vector<Entry> entries;
+
+    sqlite3* handle = nullptr;
+    auto db_path = (root.path / "cache.sqlite3").string();
+    if (sqlite3_open_v2(db_path.c_str(), &handle, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+        sqlite3_close(handle);
+        throw std::runtime_error(std::format("Unable to open the Conan 2 cache database \"{0}\"", db_path));
+    }
+    sqlite3_busy_timeout(handle, 5000);
+
+    sqlite3_stmt* stmt = nullptr;
+    auto err = sqlite3_prepare_v2(handle, R"(
+        SELECT recipes.reference, recipes.path, MAX(recipes.timestamp),
+            (SELECT COUNT(*) FROM packages WHERE packages.reference = recipes.reference)
+        FROM recipes
+        GROUP BY recipes.reference
+    )", -1, &stmt, nullptr);
+    if (err != SQLITE_OK) {
+        auto message = std::format("Unexpected Conan 2 cache database schema ({0})", sqlite3_errmsg(handle));
+        sqlite3_close(handle);
+        throw std::runtime_error(message);
+    }
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        entries.push_back({
+            reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)),
+            root.path / reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)),
+            sqlite3_column_int64(stmt, 3)
+        });
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_close(handle);
+
+    std::vector<std::optional<Recipe>> found(entries.size());
+    parallel_for(entries.size(), options.threads, [&](size_t i) {
+        // "name/version[@user/channel][#revision]"
+        std::string_view reference = entries[i].reference;
+        reference = reference.substr(0, reference.find('#'));
+        auto slash = reference.find('/'), at = reference.find('@');
+        if (slash == std::string_view::npos) return;
+        Package_reference ref{ std::string{ reference.substr(0, slash) }, {}, {}, std::string{ reference.substr(slash + 1, at - slash - 1) } };
+        if (at != std::string_view::npos) {
+            auto user_channel = reference.substr(at + 1);
+            auto slash2 = user_channel.find('/');
+            ref.user = user_channel.substr(0, slash2);
+            if (slash2 != std::string_view::npos) ref.channel = user_channel.substr(slash2 + 1);
+        }
+        if (auto info = read_recipe_info(entries[i].folder / "e"))
+            found[i] = Recipe{ std::move(ref), std::move(*info), entries[i].binaries };
+    });
+
+    std::vector<Recipe> recipes;
+    for (auto& recipe: found)
+        if (recipe) recipes.push_back(std::move(*recipe));
+    return recipes;
+}
+
+void Local_cache_indexer::index_all()
+{
+    auto start = std::chrono::steady_clock::now();
+    {
+        auto lock = std::unique_lock{mutex};
+        current_status.state = State::indexing;
+    }
+
+    std::vector<Recipe> recipes;
+    for (auto& root: options.roots) {
+        auto found = root.layout == Local_cache_root::Layout::conan1 ? read_conan1_cache(root) : read_conan2_cache(root);
+        recipes.insert(recipes.end(), std::make_move_iterator(found.begin()), std::make_move_iterator(found.end()));
+    }
+
+    // Like a scan of every letter: what is no longer in the cache is swept
+    int64_t binaries = 0;
+    for (auto& recipe: recipes) binaries += recipe.binaries;
+    Cache_writer::instance().write([&](Cache_db& db) {
+        std::map<char, int64_t> scan_gens;
+        for (auto letter = 'A'; letter <= 'Z'; letter++)
+            scan_gens[letter] = db.begin_scan(options.remote, letter);
+        for (auto& recipe: recipes) {
+            auto letter = static_cast<char>(toupper(recipe.reference.package.front()));
+            auto it = scan_gens.find(letter);
+            db.upsert_package_and_info(options.remote, recipe.reference, recipe.info, it != scan_gens.end() ? it->second : 0);
+        }
+        for (auto& [letter, scan_gen]: scan_gens)
+            db.sweep_packages(options.remote, letter, scan_gen);
+    }).get();
+
+    auto lock = std::unique_lock{mutex};
+    current_status.recipes = static_cast<int64_t>(recipes.size());
+    current_status.binaries = binaries;
+    current_status.index_duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+}
+
+void Local_cache_indexer::update_reference(Cache_db& db, const Local_cache_root& root, const Package_reference& reference)
+{
+    auto folder = root.path / reference.package / reference.version
+        / (reference.user.empty() ? "_" : reference.user) / (reference.channel.empty() ? "_" : reference.channel);
+
+    if (auto info = read_recipe_info(folder / "export")) {
+        std::cout << "Local cache: updating " << reference.package << "/" << reference.version << std::endl;
+        db.upsert_package_and_info(options.remote, reference, *info);
+    }
+    else if (db.remove_package(options.remote, reference))
+        std::cout << "Local cache: removed " << reference.package << "/" << reference.version << std::endl;
+
+    auto lock = std::unique_lock{mutex};
+    ++current_status.updates;
+}
+
+#ifdef __linux__
+
+void Local_cache_indexer::watch()
+{
+    using Reference_key = std::tuple<size_t, std::string, std::string, std::string, std::string>;   // root, name, version, user, channel
+
+    constexpr uint32_t mask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE;
+    constexpr size_t conan1_watch_depth = 5;    // down to NAME/VERSION/USER/CHANNEL/export
+
+    auto fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) throw std::runtime_error("inotify_init1() failed");
+
+    std::map<int, std::pair<size_t, fs::path>> watches; // root index and folder, by watch descriptor
+
+    auto add_watches = [&](size_t root_index, const fs::path& folder, size_t depth, auto& self) -> void {
+        auto wd = inotify_add_watch(fd, folder.c_str(), mask);
+        if (wd >= 0) watches[wd] = { root_index, folder };
+        // Conan 2 recipes are only found through the database: the root is enough
+        if (options.roots[root_index].layout == Local_cache_root::Layout::conan1 && depth < conan1_watch_depth)
+            for (auto& sub: subfolders(folder)) self(root_index, sub, depth + 1, self);
+    };
+    for (auto i = 0U; i < options.roots.size(); i++)
+        add_watches(i, options.roots[i].path, 0, add_watches);
+
+    // Changes are applied once things have settled (an install writes many files)
+    std::set<Reference_key> dirty;
+    auto full_index = false;
+    auto last_event = std::chrono::steady_clock::now();
+    alignas(inotify_event) char buffer[64 * 1024];
+
+    while (!stopping()) {
+        pollfd pfd{ fd, POLLIN, 0 };
+        if (poll(&pfd, 1, 250) > 0) {
+            for (ssize_t size; (size = read(fd, buffer, sizeof(buffer))) > 0;) {
+                for (auto p = buffer; p < buffer + size;) {
+                    auto event = reinterpret_cast<const inotify_event*>(p);
+                    p += sizeof(inotify_event) + event->len;
+
+                    auto it = watches.find(event->wd);
+                    if (it == watches.end()) continue;
+                    if (event->mask & IN_IGNORED) { watches.erase(it); continue; }
+                    auto [root_index, folder] = it->second;
+                    auto& root = options.roots[root_index];
+                    if (root.layout == Local_cache_root::Layout::conan2) { full_index = true; continue; }
+
+                    auto path = event->len > 0 ? folder / event->name : folder;
+                    std::vector<std::string> parts;
+                    for (auto& part: path.lexically_relative(root.path)) parts.push_back(part.string());
+
+                    if ((event->mask & IN_ISDIR) && (event->mask & (IN_CREATE | IN_MOVED_TO)) && parts.size() <= conan1_watch_depth)
+                        add_watches(root_index, path, parts.size(), add_watches);
+                    if (parts.size() >= 4)
+                        dirty.insert({ root_index, parts[0], parts[1], parts[2] == "_" ? "" : parts[2], parts[3] == "_" ? "" : parts[3] });
+                    else
+                        full_index = true;  // a whole name or version went away, or appeared
+                }
+            }
+            last_event = std::chrono::steady_clock::now();
+            continue;
+        }
+
+        if ((dirty.empty() && !full_index) || std::chrono::steady_clock::now() - last_event < std::chrono::milliseconds{ 300 })
+            continue;
+
+        if (full_index)
+            index_all();
+        else {
+            Cache_writer::instance().write([&](Cache_db& db) {
+                for (auto& [root_index, name, version, user, channel]: dirty)
+                    update_reference(db, options.roots[root_index], { name, user, channel, version });
+            }).get();
+        }
+        dirty.clear();
+        full_index = false;
+        auto lock = std::unique_lock{mutex};
+        current_status.state = State::watching;
+    }
+
+    close(fd);
+}
+
+#else
+
+void Local_cache_indexer::watch()
+{
+    // No watcher on this platform: the index is only refreshed on startup
+}
+
+#endif
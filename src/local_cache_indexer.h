@@ -0,0 +1,90 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include "./cache_db.h"
+#include "./types.h"
+
+
+// A local Conan cache: ~/.conan/data (Conan 1, one folder per name/version/user/channel) or ~/.conan2/p
+// (Conan 2, folders indexed by p/cache.sqlite3)
+struct Local_cache_root {
+    enum class Layout { conan1, conan2 };
+
+    std::filesystem::path   path;
+    Layout                  layout = Layout::conan1;
+
+    // Conan 2 if the folder has a cache.sqlite3
+    static auto detect(std::filesystem::path) -> Local_cache_root;
+};
+
+struct Local_cache_options {
+    std::vector<Local_cache_root>   roots;                  // see Local_cache_indexer::default_roots()
+    std::string                     remote = "local";       // name of the pseudo-remote
+    unsigned                        threads = 4;            // for the walk of the cache
+    bool                            watch = true;           // keep the index up to date (inotify, Linux only)
+};
+
+/**
+ * Indexes the recipes found in the local Conan cache(s) as the packages of a pseudo-remote, reading the
+ * cache's files instead of running conan: the metadata attributes of conanfile.py, the export time from
+ * conanmanifest.txt, and the binary packages (conaninfo.txt, Conan 1; the packages table, Conan 2).
+ *
+ * The caches are walked in parallel once at startup; after that, an inotify watcher re-reads the recipes
+ * that get installed or removed (Conan 1), or re-indexes the cache when it changes (Conan 2).
+ */
+class Local_cache_indexer {
+public:
+    enum class State { indexing, watching, idle, failed };
+
+    struct Status {
+        State                       state = State::indexing;
+        int64_t                     recipes = 0;
+        int64_t                     binaries = 0;
+        int64_t                     updates = 0;        // recipes re-read by the watcher
+        std::chrono::milliseconds   index_duration{};
+        std::string                 error;
+    };
+
+    explicit Local_cache_indexer(Local_cache_options);
+    ~Local_cache_indexer();
+
+    // The caches of the current user (CONAN_USER_HOME / CONAN_HOME are honoured) that exist
+    static auto default_roots() -> std::vector<Local_cache_root>;
+
+    auto status() -> Status;
+    void draw_status();
+
+private:
+
+    struct Recipe {
+        Package_reference   reference;
+        Package_info        info;
+        int64_t             binaries = 0;
+    };
+
+    void run();
+    void index_all();
+    auto read_conan1_cache(const Local_cache_root&) -> std::vector<Recipe>;
+    auto read_conan2_cache(const Local_cache_root&) -> std::vector<Recipe>;
+    void update_reference(Cache_db&, const Local_cache_root&, const Package_reference&);
+    void watch();
+
+    bool stopping();
+
+    Local_cache_options         options;
+
+    std::mutex                  mutex;
+    std::condition_variable     cond_var;
+    Status                      current_status;
+    bool                        term_flag = false;
+
+    std::thread                 thread;
+};
@@ -3,13 +3,20 @@
 #include <map>
 #include <cassert>
 #include <array>
+#include <algorithm>
 #include <span>
+#include <memory>
 #include <imgui.h>
 #include <format>
 #include "./cache_db.h"
+#include "./cache_writer.h"
 #include "./repo_reader.h"
 #include "./imgui_app.h"
 #include "./alphabetic_tree.h"
+#include "./info_crawler.h"
+#include "./local_cache_indexer.h"
+#include "./job_queue.h"
+#include "./gui_elements.h"
 
 
 using namespace Conan;
@@ -69,22 +76,137 @@ static void show_query_result_node(
 #endif // OLD_CODE
 
 
+static void draw_response_cache_status(Repository_reader& repo_reader)
+{
+    auto stats = repo_reader.response_cache_stats();
+    gui::FormattedText("Response cache: {0} hits, {1} misses, {2} bypassed", stats.hits, stats.misses, stats.bypassed);
+    ImGui::SameLine();
+    if (ImGui::SmallButton("Clear cache"))
+        Job_queue::instance().queue_job([&repo_reader]() { repo_reader.invalidate_response_cache(); }, Job_queue::Priority::high);
+}
+
+static void draw_statement_cache_status()
+{
+    auto stats = SQLite::statement_cache_stats();
+    auto lookups = stats.hits + stats.misses;
+    gui::FormattedText("Statement cache: {0} hits, {1} prepared, {2} evicted ({3}% hit rate)", stats.hits, stats.misses,
+        stats.evictions, lookups > 0 ? 100 * stats.hits / lookups : 0);
+}
+
+static void draw_cache_writer_status()
+{
+    auto stats = Cache_writer::instance().stats();
+    gui::FormattedText("Cache writes: {0} in {1} transactions ({2:.1f} per batch, max {3}), {4:.1f} ms per commit (max {5:.1f}), "
+        "{6:.1f} ms until committed, {7} queued, {8} failed", stats.mutations, stats.transactions, stats.mean_batch, stats.max_batch,
+        stats.mean_commit_ms, stats.max_commit_ms, stats.mean_wait_ms, stats.queued, stats.failed);
+    if (auto& backfill = stats.backfill; backfill && !backfill->finished)
+        gui::FormattedText("Cache upgrade ({0}): {1} of {2} rows", backfill->name, backfill->rows_done, backfill->rows_total);
+}
+
+static void draw_remote_limits(Repository_reader& repo_reader)
+{
+    auto limits = repo_reader.remote_limits();
+    if (limits.empty() || !ImGui::TreeNode("Remote limits")) return;
+
+    for (auto& remote: limits) {
+        std::string latencies;
+        for (auto& [operation, latency]: remote.latencies)
+            latencies += std::format(", {0} {1} ms", operation, latency.count());
+        gui::FormattedText("{0}: {1} calls/s, {2} concurrent ({3} running); {4} calls, {5} errors, {6} slow{7}",
+            remote.remote, remote.rate, remote.limit, remote.in_flight, remote.calls, remote.errors, remote.spikes, latencies);
+    }
+    ImGui::TreePop();
+}
+
+
 int main(int, char **)
 {
     try {
-
-        Conan::Repository_reader repo_reader;
+        // All the cache writes go through it: it is created first so that it is destroyed last (after the job
+        // queue, whose jobs write); mutations per transaction, and how long they can wait for others
+        Writer_options writer_options;
+        if (auto batch = getenv("CONAN_GUI_WRITE_BATCH")) writer_options.max_batch = std::max(1, atoi(batch));
+        if (auto delay = getenv("CONAN_GUI_WRITE_DELAY_MS")) writer_options.max_delay = std::chrono::milliseconds{ std::max(0, atoi(delay)) };
+        // Rows per transaction of the background upgrades of the cache (see Cache_db::run_backfill_chunk()), and
+        // the pause between the transactions
+        if (auto chunk = getenv("CONAN_GUI_BACKFILL_CHUNK")) writer_options.backfill_chunk = std::max(1, atoi(chunk));
+        if (auto pause = getenv("CONAN_GUI_BACKFILL_PAUSE_MS")) writer_options.backfill_pause = std::chrono::milliseconds{ std::max(0, atoi(pause)) };
+        Cache_writer::instance().configure(writer_options);
+
+        Conan::Reader_options reader_options;
+        // CONAN_GUI_CONAN_EXE can point to a stand-in executable (e.g. tools/fake_conan) for offline scale tests
+        if (auto conan_exe = getenv("CONAN_GUI_CONAN_EXE")) reader_options.conan_exe = conan_exe;
+        // Record a session, or replay a recorded one (optionally accelerated; speed 0 = no waiting)
+        if (auto record_file = getenv("CONAN_GUI_RECORD")) reader_options.record_file = record_file;
+        if (auto replay_file = getenv("CONAN_GUI_REPLAY")) reader_options.replay_file = replay_file;
+        if (auto replay_speed = getenv("CONAN_GUI_REPLAY_SPEED")) reader_options.replay_speed = atof(replay_speed);
+        // Tuning of the prefix splitting of letter scans
+        if (auto threshold = getenv("CONAN_GUI_SPLIT_THRESHOLD")) reader_options.split_threshold = atoll(threshold);
+        if (auto parallel = getenv("CONAN_GUI_PARALLEL_SEARCHES")) reader_options.parallel_searches = std::max(1, atoi(parallel));
+        // How long conan responses are reused (seconds, 0 = no response cache)
+        if (auto ttl = getenv("CONAN_GUI_SEARCH_CACHE_TTL")) reader_options.search_cache_ttl = atoll(ttl);
+        if (auto ttl = getenv("CONAN_GUI_INSPECT_CACHE_TTL")) reader_options.inspect_cache_ttl = atoll(ttl);
+        // Talk to the remotes directly (REST API) rather than through conan
+        if (auto rest = getenv("CONAN_GUI_REST")) reader_options.use_rest_api = atoi(rest) != 0;
+        if (auto connections = getenv("CONAN_GUI_REST_CONNECTIONS")) reader_options.rest_connections = std::max(1, atoi(connections));
+        // Calls per second to each remote ("RATE[,REMOTE=RATE...]", 0 = no limit), and ceiling of their concurrency
+        if (auto rates = getenv("CONAN_GUI_REMOTE_RATE")) reader_options.governor = Governor_options::parse_rates(rates, reader_options.governor);
+        if (auto concurrency = getenv("CONAN_GUI_REMOTE_CONCURRENCY")) reader_options.governor.max_limit = std::max(1, atoi(concurrency));
+        // Deadline of every call to a remote (seconds), and attempts at calls that fail transiently
+        if (auto timeout = getenv("CONAN_GUI_CALL_TIMEOUT")) reader_options.call_timeout = std::chrono::seconds{ std::max(1, atoi(timeout)) };
+        if (auto attempts = getenv("CONAN_GUI_CALL_ATTEMPTS")) reader_options.retry.max_attempts = std::max(1, atoi(attempts));
+        // Conan home to read the remote list from (instead of ~/.conan and ~/.conan2)
+        if (auto conan_home = getenv("CONAN_GUI_CONAN_HOME")) reader_options.conan_homes = { conan_home };
+
+        Conan::Repository_reader repo_reader{ reader_options };
 
         imgui_init("Conan GUI");
 
-        Alphabetic_tree alphabetic_tree{ repo_reader };
+        // Time-to-live of package info (overall and per remote), and rate of the background refreshes
+        Info_freshness freshness;
+        if (auto ttl = getenv("CONAN_GUI_INFO_TTL")) freshness = Info_freshness::parse(ttl);
+        if (auto rate = getenv("CONAN_GUI_REFRESH_RATE")) freshness.refresh_rate = atof(rate);
+
+        // The local cache is indexed from its files (CONAN_GUI_LOCAL_CACHE=0 to disable, CONAN_GUI_LOCAL_CACHE_DIRS
+        // to index other caches than the user's, separated by ';'); its info is kept up to date by the indexer
+        std::unique_ptr<Local_cache_indexer> local_cache_indexer;
+        if (auto local = getenv("CONAN_GUI_LOCAL_CACHE"); !local || atoi(local) != 0) {
+            Local_cache_options local_options;
+            if (auto dirs = getenv("CONAN_GUI_LOCAL_CACHE_DIRS")) {
+                for (std::string_view list = dirs; !list.empty();) {
+                    auto sep = list.find(';');
+                    if (auto dir = list.substr(0, sep); !dir.empty()) local_options.roots.push_back(Local_cache_root::detect(dir));
+                    list = sep == std::string_view::npos ? std::string_view{} : list.substr(sep + 1);
+                }
+            }
+            else
+                local_options.roots = Local_cache_indexer::default_roots();
+            if (!local_options.roots.empty()) {
+                freshness.remote_ttls[local_options.remote] = std::chrono::hours{ 24 * 365 * 100 };
+                local_cache_indexer = std::make_unique<Local_cache_indexer>(std::move(local_options));
+            }
+        }
+
+        Alphabetic_tree alphabetic_tree{ repo_reader, freshness };
         alphabetic_tree.get_from_database();
 
+        // Background crawler filling in the info nobody asked for yet (inspects per second, overall and per remote)
+        Crawler_options crawler_options;
+        if (auto rate = getenv("CONAN_GUI_CRAWL_RATE")) crawler_options.rate = atof(rate);
+        if (auto rate = getenv("CONAN_GUI_CRAWL_REMOTE_RATE")) crawler_options.remote_rate = atof(rate);
+        Info_crawler info_crawler{ repo_reader, crawler_options };
+
         while (imgui_continue()) {
     
             imgui_new_frame();
             
             if (ImGui::Begin("Conan")) {
+                info_crawler.draw_status();
+                draw_response_cache_status(repo_reader);
+                draw_statement_cache_status();
+                draw_cache_writer_status();
+                draw_remote_limits(repo_reader);
+                if (local_cache_indexer) local_cache_indexer->draw_status();
                 alphabetic_tree.draw();
             }
             ImGui::End();
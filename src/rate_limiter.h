@@ -0,0 +1,53 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+
+// Token bucket: holds up to "burst" tokens, replenished at "rate" tokens per second. A rate of 0 means
+// no limit.
+class Rate_limiter {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit Rate_limiter(double rate_ = 0, double burst_ = 1) { configure(rate_, burst_); }
+
+    void configure(double rate_, double burst_) {
+        auto lock = std::unique_lock{ mutex };
+        rate = rate_;
+        burst = std::max(burst_, 1.0);
+        tokens = burst;
+        last_refill = Clock::now();
+    }
+
+    // Takes "cost" tokens if they are available; if not, tells when they will be
+    bool try_acquire(double cost, Clock::time_point& ready_at) {
+        auto lock = std::unique_lock{ mutex };
+        if (rate <= 0) return true;
+
+        cost = std::min(cost, burst); // or it would never be granted
+        auto now = Clock::now();
+        tokens = std::min(burst, tokens + rate * std::chrono::duration<double>(now - last_refill).count());
+        last_refill = now;
+        if (tokens >= cost) {
+            tokens -= cost;
+            return true;
+        }
+        ready_at = now + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>((cost - tokens) / rate));
+        return false;
+    }
+
+    void acquire(double cost = 1) {
+        for (Clock::time_point ready_at; !try_acquire(cost, ready_at);)
+            std::this_thread::sleep_until(ready_at);
+    }
+
+private:
+    std::mutex          mutex;
+    double              rate = 0;
+    double              burst = 1;
+    double              tokens = 1;
+    Clock::time_point   last_refill;
+};
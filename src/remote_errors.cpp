@@ -0,0 +1,46 @@
+#include <algorithm>
+#include <random>
+#include <regex>
+#include "./remote_errors.h"
+
+
+namespace Conan {
+
+    auto failure_name(Failure_kind kind) -> std::string_view
+    {
+        switch (kind) {
+        case Failure_kind::none     : return "none";
+        case Failure_kind::transient: return "transient";
+        case Failure_kind::auth     : return "auth";
+        case Failure_kind::not_found: return "not found";
+        case Failure_kind::parse    : return "parse";
+        }
+        return "?";
+    }
+
+    auto classify_failure(const Command_result& result) -> Failure_kind
+    {
+        if (result.timed_out) return Failure_kind::transient;
+        if (result.exit_code == 0) return Failure_kind::none;
+
+        static const auto auth = std::regex(R"(\b(401|403)\b|unauthorized|forbidden|authentication|credentials)", std::regex::icase);
+        static const auto not_found = std::regex(R"(\b404\b|not found|unable to find|doesn't exist|does not exist|no remote '[^']*' defined)", std::regex::icase);
+        static const auto parse = std::regex(R"(unexpected response|parse error|invalid json)", std::regex::icase);
+
+        // conan prints its errors on stderr, but the last lines of stdout may explain them too
+        auto text = result.errors + result.output.substr(result.output.size() - std::min<size_t>(result.output.size(), 1024));
+        if (std::regex_search(text, auth)) return Failure_kind::auth;
+        if (std::regex_search(text, not_found)) return Failure_kind::not_found;
+        if (std::regex_search(text, parse)) return Failure_kind::parse;
+        return Failure_kind::transient;
+    }
+
+    auto Retry_policy::delay(int retry) const -> std::chrono::milliseconds
+    {
+        thread_local std::mt19937_64 rng{ std::random_device{}() };
+
+        auto cap = std::min<int64_t>(max_delay.count(), base_delay.count() << std::clamp(retry - 1, 0, 20));
+        return std::chrono::milliseconds{ std::uniform_int_distribution<int64_t>{ 0, std::max<int64_t>(cap, 0) }(rng) };
+    }
+
+} // ns Conan
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <chrono>
+#include <string_view>
+#include "./command_runner.h"
+
+
+namespace Conan {
+
+    // Why a call to a remote (a conan command, or a REST request reported like one) failed. Only transient
+    // failures are worth retrying.
+    enum class Failure_kind { none, transient, auth, not_found, parse };
+
+    auto failure_name(Failure_kind) -> std::string_view;
+
+    // From the exit code and the messages: timeouts, connection errors, HTTP 5xx/429 and unrecognized errors
+    // are transient; HTTP 401/403 are auth failures, HTTP 404 and unknown references/remotes not-found ones
+    auto classify_failure(const Command_result&) -> Failure_kind;
+
+    // Capped exponential backoff with full jitter: the n-th retry waits a random time up to
+    // min(max_delay, base_delay * 2^(n-1))
+    struct Retry_policy {
+        int                         max_attempts = 3;
+        std::chrono::milliseconds   base_delay{ 500 };
+        std::chrono::milliseconds   max_delay{ 15000 };
+
+        auto delay(int retry) const -> std::chrono::milliseconds;
+    };
+
+} // ns Conan
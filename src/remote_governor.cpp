@@ -0,0 +1,101 @@
+#include <algorithm>
+#include <cmath>
+#include "./remote_governor.h"
+
+
+namespace Conan {
+
+    auto Governor_options::parse_rates(std::string_view spec, Governor_options options) -> Governor_options
+    {
+        while (!spec.empty()) {
+            auto item = spec.substr(0, spec.find(','));
+            spec.remove_prefix(std::min(spec.size(), item.size() + 1));
+            auto equals = item.find('=');
+            auto rate = std::atof(std::string{ item.substr(equals + 1) }.c_str());
+            if (equals == std::string_view::npos)
+                options.rate = rate;
+            else
+                options.remote_rates[std::string{ item.substr(0, equals) }] = rate;
+        }
+        return options;
+    }
+
+    Remote_governor::Remote_governor(Governor_options options_):
+        options{std::move(options_)}
+    {
+    }
+
+    bool Remote_governor::succeeded(const std::vector<Command_result>& results)
+    {
+        return std::any_of(results.begin(), results.end(), [](auto& result) { return succeeded(result); });
+    }
+
+    auto Remote_governor::admit(std::string_view remote, int calls) -> Remote&
+    {
+        auto lock = std::unique_lock{mutex};
+        auto it = remotes.find(remote);
+        if (it == remotes.end()) {
+            auto state = std::make_unique<Remote>();
+            auto rate = options.remote_rates.find(remote);
+            state->limiter.configure(rate != options.remote_rates.end() ? rate->second : options.rate, options.burst);
+            state->limit = std::clamp(options.initial_limit, options.min_limit, options.max_limit);
+            it = remotes.emplace(std::string{ remote }, std::move(state)).first;
+        }
+        auto& state = *it->second;
+        lock.unlock();
+
+        // Rate first, so that waiting for tokens does not hold a slot
+        state.limiter.acquire(calls);
+
+        lock.lock();
+        slot_cv.wait(lock, [&]() { return state.in_flight < std::max(1, static_cast<int>(state.limit)); });
+        ++state.in_flight;
+        return state;
+    }
+
+    void Remote_governor::complete(Remote& state, std::string_view operation, Clock::time_point started, int calls, bool ok)
+    {
+        auto now = Clock::now();
+        auto ms_per_call = std::chrono::duration<double, std::milli>(now - started).count() / std::max(1, calls);
+
+        auto lock = std::unique_lock{mutex};
+        --state.in_flight;
+        state.calls += calls;
+
+        auto it = state.latencies.find(operation);
+        auto spike = ok && it != state.latencies.end() && ms_per_call > it->second * options.spike_factor;
+        if (!ok || spike) {
+            ++(ok ? state.spikes : state.errors);
+            // Calls started before the last decrease ran under the previous limit: they do not count again
+            if (started > state.last_decrease) {
+                state.limit = std::max(options.min_limit, state.limit * options.backoff);
+                state.last_decrease = now;
+            }
+        }
+        else {
+            state.limit = std::min(options.max_limit, state.limit + calls / state.limit);
+            if (it == state.latencies.end())
+                state.latencies.emplace(std::string{ operation }, ms_per_call);
+            else
+                it->second += (ms_per_call - it->second) * 0.1;
+        }
+
+        slot_cv.notify_all();
+    }
+
+    auto Remote_governor::limits() -> std::vector<Remote_limits>
+    {
+        auto lock = std::unique_lock{mutex};
+        std::vector<Remote_limits> list;
+        for (auto& [name, state]: remotes) {
+            auto rate = options.remote_rates.find(name);
+            Remote_limits limits{ name, rate != options.remote_rates.end() ? rate->second : options.rate,
+                std::max(1, static_cast<int>(state->limit)), state->in_flight, state->calls, state->errors, state->spikes };
+            for (auto& [operation, ms]: state->latencies)
+                limits.latencies[operation] = std::chrono::milliseconds{ std::lround(ms) };
+            list.push_back(std::move(limits));
+        }
+        return list;
+    }
+
+} // ns Conan
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "./command_runner.h"
+#include "./rate_limiter.h"
+#include "./remote_errors.h"
+
+
+namespace Conan {
+
+    struct Governor_options {
+        double      rate = 10;              // calls per second to any one remote (0 = no limit)
+        double      burst = 10;
+        std::map<std::string, double, std::less<>> remote_rates;    // overrides "rate" for some remotes
+        double      initial_limit = 4;      // concurrent calls to a remote
+        double      min_limit = 1;
+        double      max_limit = 16;
+        double      backoff = 0.5;          // the concurrency limit is multiplied by this on errors and latency spikes
+        double      spike_factor = 3;       // calls taking that many times the usual latency are spikes
+
+        // Rates given as "RATE[,REMOTE=RATE...]", e.g. "10,conancenter=2"; the rest is taken from defaults
+        static auto parse_rates(std::string_view spec, Governor_options defaults) -> Governor_options;
+    };
+
+    struct Remote_limits {
+        std::string                 remote;
+        double                      rate = 0;           // calls per second (0 = no limit)
+        int                         limit = 0;          // concurrent calls allowed right now
+        int                         in_flight = 0;
+        int64_t                     calls = 0;
+        int64_t                     errors = 0;
+        int64_t                     spikes = 0;
+        std::map<std::string, std::chrono::milliseconds> latencies;    // usual latency, by operation
+    };
+
+    /**
+     * Governs the calls made to each remote: a token bucket caps their rate, and an AIMD limit caps how many
+     * run at once. The limit grows by one for each limit's worth of successful calls, and is halved (at most
+     * once per round of calls) when a call fails transiently or takes much longer than usual for its
+     * operation, so that it settles just below the point where the remote starts throttling.
+     */
+    class Remote_governor {
+    public:
+        using Clock = Rate_limiter::Clock;
+
+        explicit Remote_governor(Governor_options = {});
+
+        // Runs fn() once the remote can take "calls" more calls (fn can make a batch of them); the result
+        // tells whether it went well
+        template <typename Fn>
+        auto call(std::string_view remote, std::string_view operation, int calls, Fn fn) -> decltype(fn());
+
+        auto limits() -> std::vector<Remote_limits>;
+
+    private:
+
+        struct Remote {
+            Rate_limiter                limiter;
+            double                      limit = 1;
+            int                         in_flight = 0;
+            int64_t                     calls = 0, errors = 0, spikes = 0;
+            std::map<std::string, double, std::less<>> latencies;   // ms per call, moving average
+            Clock::time_point           last_decrease;
+        };
+
+        // Only transient failures are a sign of distress (a missing package is not)
+        static bool succeeded(const Command_result& result) { return classify_failure(result) != Failure_kind::transient; }
+        static bool succeeded(const std::vector<Command_result>&);  // a batch fails if all its calls do
+
+        auto admit(std::string_view remote, int calls) -> Remote&;
+        void complete(Remote&, std::string_view operation, Clock::time_point started, int calls, bool ok);
+
+        Governor_options            options;
+        std::mutex                  mutex;
+        std::condition_variable     slot_cv;
+        std::map<std::string, std::unique_ptr<Remote>, std::less<>> remotes;
+    };
+
+    template <typename Fn>
+    auto Remote_governor::call(std::string_view remote, std::string_view operation, int calls, Fn fn) -> decltype(fn())
+    {
+        auto& state = admit(remote, calls);
+        auto started = Clock::now();
+        try {
+            auto result = fn();
+            complete(state, operation, started, calls, succeeded(result));
+            return result;
+        }
+        catch (...) {
+            complete(state, operation, started, calls, false);
+            throw;
+        }
+    }
+
+} // ns Conan
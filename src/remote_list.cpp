@@ -0,0 +1,101 @@
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <nlohmann/json.hpp>
+#include "./string_utils.h"
+#include "./remote_list.h"
+
+
+namespace fs = std::filesystem;
+
+
+auto default_conan_homes() -> std::vector<fs::path>
+{
+    auto env_path = [](const char* name) -> fs::path {
+        auto value = getenv(name);
+        return value ? fs::path{ value } : fs::path{};
+    };
+
+    auto home = env_path("HOME");
+    if (home.empty()) home = env_path("USERPROFILE");
+
+    auto conan1_home = env_path("CONAN_USER_HOME");
+    auto conan2_home = env_path("CONAN_HOME");
+    return {
+        (conan1_home.empty() ? home : conan1_home) / ".conan",
+        conan2_home.empty() ? home / ".conan2" : conan2_home
+    };
+}
+
+static auto read_remotes_json(const fs::path& path) -> std::vector<Remote_entry>
+{
+    std::vector<Remote_entry> remotes;
+    std::ifstream is{ path };
+    auto json = nlohmann::json::parse(is);
+    for (auto& remote: json.at("remotes")) {
+        remotes.push_back({
+            .name       = remote.at("name").get<std::string>(),
+            .url        = remote.at("url").get<std::string>(),
+            .verify_ssl = remote.value("verify_ssl", true),
+            .enabled    = !remote.value("disabled", false),
+            .priority   = static_cast<int64_t>(remotes.size()),
+        });
+    }
+    return remotes;
+}
+
+// "name url True" per line
+static auto read_remotes_txt(const fs::path& path) -> std::vector<Remote_entry>
+{
+    std::vector<Remote_entry> remotes;
+    std::ifstream is{ path };
+    for (std::string line; std::getline(is, line);) {
+        std::istringstream fields{ line };
+        Remote_entry remote;
+        std::string verify_ssl;
+        if (!(fields >> remote.name >> remote.url)) continue;
+        if (fields >> verify_ssl) remote.verify_ssl = verify_ssl != "False";
+        remote.priority = static_cast<int64_t>(remotes.size());
+        remotes.push_back(std::move(remote));
+    }
+    return remotes;
+}
+
+auto read_remote_files(const std::vector<fs::path>& conan_homes) -> std::vector<Remote_entry>
+{
+    for (auto& home: conan_homes) {
+        std::error_code ec;
+        try {
+            if (fs::exists(home / "remotes.json", ec)) return read_remotes_json(home / "remotes.json");
+            if (fs::exists(home / "remotes.txt", ec)) return read_remotes_txt(home / "remotes.txt");
+        }
+        catch (const std::exception& e) {
+            std::cerr << "***Unable to read the remotes of " << home.string() << ": " << e.what() << std::endl;
+        }
+    }
+    return {};
+}
+
+auto parse_remote_list(std::string_view output) -> std::vector<Remote_entry>
+{
+    std::vector<Remote_entry> remotes;
+    for_each_line(output, [&](std::string_view line) {
+        auto colon = line.find(':');
+        if (colon == std::string_view::npos || colon == 0) return;
+        Remote_entry remote{ .name = std::string{ line.substr(0, colon) }, .priority = static_cast<int64_t>(remotes.size()) };
+
+        auto rest = line.substr(colon + 1);
+        auto bracket = rest.find(" [");
+        auto url = rest.substr(0, bracket);
+        while (url.starts_with(' ')) url.remove_prefix(1);
+        remote.url = url;
+        if (bracket != std::string_view::npos) {
+            auto flags = rest.substr(bracket);
+            remote.verify_ssl = flags.find("Verify SSL: False") == std::string_view::npos;
+            remote.enabled = flags.find("Disabled: True") == std::string_view::npos;
+        }
+        remotes.push_back(std::move(remote));
+    });
+    return remotes;
+}
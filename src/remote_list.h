@@ -0,0 +1,18 @@
+#pragma once
+
+#include <filesystem>
+#include <string_view>
+#include <vector>
+#include "./types.h"
+
+
+// Where conan keeps its configuration: CONAN_USER_HOME/.conan (Conan 1), then CONAN_HOME (Conan 2), with
+// the user's home folder as default
+auto default_conan_homes() -> std::vector<std::filesystem::path>;
+
+// The remotes as conan has them in its files, without running it: remotes.json (Conan 1.x and 2), or
+// remotes.txt (older Conan 1), from the first home that has one; empty if none has
+auto read_remote_files(const std::vector<std::filesystem::path>& conan_homes) -> std::vector<Remote_entry>;
+
+// From the output of "conan remote list": "name: url [Verify SSL: True, Disabled: True]"
+auto parse_remote_list(std::string_view output) -> std::vector<Remote_entry>;
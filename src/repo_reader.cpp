@@ -2,125 +2,497 @@
 #include <cstdio>
 #include <iostream>
 #include <future>
+#include <atomic>
 #include <regex>
 #include <cassert>
+#include <thread>
 #include <format>
 #include "./cache_db.h"
+#include "./cache_writer.h"
+#include "./conan_metadata.h"
+#include "./remote_list.h"
 #include "./repo_reader.h"
 
 
 namespace Conan {
+
+    // A replayed session does not reach the remotes
+    static auto governor_options(const Reader_options& options) -> Governor_options
+    {
+        if (options.replay_file.empty()) return options.governor;
+        return { .rate = 0, .initial_limit = 1000, .max_limit = 1000 };
+    }
     
-    Repository_reader::Repository_reader()
-    {
-        remotes_ad.obtain([]() {
-            auto file_ptr = _popen("conan remote list", "r");
-            if (!file_ptr) throw std::system_error(errno, std::generic_category());
-            std::vector<std::string> list;
-            while (!feof(file_ptr)) {
-                char buffer[1024];
-                if (fgets(buffer, sizeof(buffer), file_ptr)) {
-                    std::string input = buffer;
-                    input.erase(std::remove(input.begin(), input.end(), '\n'), input.end());
-                    auto version = input.substr(0, input.find(":"));
-                    std::cout << version << std::endl; // TODO: replace with log
-                    list.push_back(version);
-                }
-            }
-            fclose(file_ptr);
-            return list;
+    // First line of the error messages of a failed call
+    static auto error_message(const Command_result& result) -> std::string
+    {
+        std::string message;
+        for_each_line(result.errors, [&](std::string_view line) {
+            if (message.empty() && line.find_first_not_of(" \t\r") != std::string_view::npos) message = line;
         });
+        return message.empty() ? std::format("exit code {0}", result.exit_code) : message;
+    }
+
+    Repository_reader::Repository_reader(Reader_options options_):
+        options{std::move(options_)},
+        governor{governor_options(options)}
+    {
+        {
+            Cache_db db;
+            for (auto& failure: db.get_remote_failures())
+                failing_remotes.insert(failure.remote);
+        }
+
+        if (!options.replay_file.empty()) replay = Command_archive::open(options.replay_file);
+        if (!options.record_file.empty()) recording = Command_archive::create(options.record_file);
+
+        // The remotes of the previous session can be used while the list is refreshed
+        if (!recording && !replay) {
+            Cache_db db;
+            remote_list = db.get_remotes();
+            remotes_known = !remote_list.empty();
+        }
+        remotes_refresh = std::async(std::launch::async, [this]() { refresh_remotes(); });
     }
     
-    void Repository_reader::filtered_read(std::string_view remote, std::string_view name_filter)
+    // Characters that can follow the first one in a package name (Conan: [a-zA-Z0-9_][a-zA-Z0-9_+.-]{1,50});
+    // searches are case-insensitive, so the lower case letters cover the upper case ones
+    static constexpr std::string_view name_chars = "abcdefghijklmnopqrstuvwxyz0123456789_+.-";
+
+    bool Repository_reader::filtered_read(std::string_view remote, std::string_view name_filter, int64_t scan_gen)
     {
-        update_package_list(remote, name_filter);
+        return update_package_list(remote, name_filter, scan_gen).ok;
     }
 
-    void Repository_reader::read_letter_all_repositories(char letter)
+    void Repository_reader::plan_searches(const std::string& prefix, const std::map<std::string, int64_t>& results, std::vector<Name_search>& searches) const
+    {
+        // A prefix is only split once its size is known, i.e. after it has been searched as a whole
+        auto it = results.find(prefix);
+        if (it == results.end() || it->second <= options.split_threshold || prefix.size() >= options.max_prefix_length) {
+            searches.push_back({ prefix });
+            return;
+        }
+
+        // The sub-prefixes cover the names that are longer than the prefix, the exact search the one that is
+        // equal to it (package names have at least 2 characters): no gaps, no overlaps
+        if (prefix.size() >= 2) searches.push_back({ prefix, true });
+        for (auto ch: name_chars)
+            plan_searches(prefix + ch, results, searches);
+    }
+
+    auto Repository_reader::read_letter_all_repositories(char letter, bool bypass_cache) -> Letter_scan_result
     {
         assert(letter >= 'A' && letter <= 'Z');
 
-        auto& remotes = remotes_ad.get();
+        struct Search {
+            std::string_view    remote;
+            Name_search         names;
+            int64_t             scan_gen;
+            Search_outcome      outcome;
+            bool                completed = false;  // by the interrupted scan being resumed
+        };
+
+        Letter_scan_result result;
+
+        Cache_db db;
+        auto prefix = std::string(1, static_cast<char>(tolower(letter)));
+
+        // Plan the searches of all remotes
+        std::vector<Search> searches;
+        std::vector<std::string> remotes;   // (the enabled ones, by priority)
+        for (auto& remote: this->remotes())
+            if (remote.enabled) remotes.push_back(remote.name);
         for (auto& remote: remotes) {
-            filtered_read(remote, std::format("{:c}*", letter));
-            filtered_read(remote, std::format("{:c}*", letter + 'a' - 'A'));
+            std::vector<Name_search> names;
+            plan_searches(prefix, db.get_prefix_results(remote), names);
+            // Resume the scan that failed or got interrupted, if any
+            auto scan_gen = bypass_cache ? 0 : db.get_resumable_scan(remote, letter);
+            auto completed = scan_gen != 0 ? db.get_completed_searches(scan_gen) : std::map<std::string, Completed_search>{};
+            if (scan_gen == 0)
+                scan_gen = Cache_writer::instance().write([&](Cache_db& db) { return db.begin_scan(remote, letter); }).get();
+            for (auto& name_search: names) {
+                Search search{ remote, name_search, scan_gen };
+                if (auto it = completed.find(name_search.pattern()); it != completed.end()) {
+                    search.outcome = { .ok = true, .results = it->second.results, .duration = std::chrono::milliseconds{ it->second.duration_ms } };
+                    search.completed = true;
+                    ++result.resumed;
+                }
+                searches.push_back(std::move(search));
+            }
         }
 
-        Cache_db db;
-        db.mark_letter_as_scanned(letter);
+        // Run them in parallel
+        std::vector<Search*> pending;
+        for (auto& search: searches)
+            if (!search.completed) pending.push_back(&search);
+        std::atomic<size_t> next = 0;
+        std::vector<std::future<void>> workers;
+        for (auto i = 0U; i < std::min<size_t>(options.parallel_searches, pending.size()); i++) {
+            workers.push_back(std::async(std::launch::async, [&]() {
+                for (size_t j; (j = next++) < pending.size();) {
+                    auto& search = *pending[j];
+                    try {
+                        search.outcome = update_package_list(search.remote, search.names.pattern(), search.scan_gen, bypass_cache);
+                    }
+                    catch (const std::exception& e) {
+                        search.outcome = { .failure = Failure_kind::transient, .error = e.what() };
+                    }
+                }
+            }));
+        }
+        for (auto& worker: workers) worker.get();
+
+        // Sweep the remotes that could be read completely, and keep the statistics for the next scan (all of
+        // it in one mutation: a sweep must not be committed without the letter being marked as scanned)
+        Cache_writer::instance().write([&](Cache_db& db) {
+            for (auto& remote: remotes) {
+                std::map<std::string, std::pair<int64_t, int64_t>> stats; // results and duration (ms) by prefix
+                auto ok = true;
+                int64_t scan_gen = 0;
+                std::string failure;
+                for (auto& search: searches) {
+                    if (search.remote != remote) continue;
+                    scan_gen = search.scan_gen;
+                    if (!search.outcome.ok && failure.empty())
+                        failure = std::format("{0} ({1}): {2}", search.names.pattern(), failure_name(search.outcome.failure), search.outcome.error);
+                    ok = ok && search.outcome.ok;
+                    // A search counts for its own prefix and all the ones it was split from
+                    for (auto length = 1U; length <= search.names.prefix.size(); length++) {
+                        auto& [results, duration] = stats[search.names.prefix.substr(0, length)];
+                        results += search.outcome.results;
+                        duration += search.outcome.duration.count() / 1000;
+                    }
+                }
+                // Sweeping after a failed search would purge everything it did not get to
+                if (!ok) {
+                    db.mark_scan_failed(scan_gen, failure);
+                    result.failures[remote] = failure;
+                    continue;
+                }
+                for (auto& [prefix, stat]: stats)
+                    db.update_prefix_stats(remote, prefix, stat.first, stat.second);
+                auto swept = db.sweep_packages(remote, letter, scan_gen);
+                result.removed.insert(result.removed.end(), swept.begin(), swept.end());
+            }
+            db.mark_letter_as_scanned(letter);
+        }).get();
+
+        return result;
+    }
+
+    auto Repository_reader::get_info(const Package_key& key, bool bypass_cache) -> Package_info
+    {
+        return try_get_info(key, bypass_cache).value_or(Package_info{});
+    }
+
+    auto Repository_reader::try_get_info(const Package_key& key, bool bypass_cache) -> std::optional<Package_info>
+    {
+        return try_get_infos({ key }, bypass_cache).front();
     }
 
-    auto Repository_reader::get_info(const Package_key& key) -> Package_info
+    auto Repository_reader::inspect_args(const Package_key& key) -> std::string
     {
         std::string specifier = std::format("{0}/{1}@", key.reference.package, key.reference.version);
         if (!key.reference.user.empty()) specifier += std::format("{0}/{1}", key.reference.user, key.reference.channel);
             
         // auto cmd = fmt::format("conan info -r {0} {1}", remote, specifier);
-        auto cmd = std::format("conan inspect -r {0} {1}", key.remote, specifier);
-        std::cout << "INSPECT command: " << cmd << std::endl;
-        auto file_ptr = _popen(cmd.c_str(), "r");
-        if (!file_ptr) throw std::system_error(errno, std::generic_category());
-
-        // auto re = std::regex("^[ \t]+([^:]+):[ \t]*(.*)$");
-        auto re = std::regex("^([^:]+):[ \t]*(.*)$");
-
-        Package_info info;
-
-        while (!feof(file_ptr)) {
-            char buffer[1024];
-            if (fgets(buffer, sizeof(buffer), file_ptr)) {
-                std::string input = buffer;
-                input.erase(std::remove(input.begin(), input.end(), '\n'), input.end());
-                std::cout << input << std::endl;
-                std::smatch m;
-                if (std::regex_match(input, m, re)) {
-                    // if (m[1] == "Description") info.description = m[2];
-                    if      (m[1] == "description") info.description = m[2];
-                    else if (m[1] == "license"    ) info.license     = m[2];
-                    else if (m[1] == "provides"   ) info.provides    = m[2];
-                    else if (m[1] == "author"     ) info.author      = m[2];
-                    else if (m[1] == "topics"     ) info.topics      = parseTagList(m[2].str());
-                }
-                else {
-                    std::cerr << "***FAILED to parse info line \"" << input << "\"" << std::endl;
+        return std::format("inspect -r {0} {1}", key.remote, specifier);
+    }
+
+    auto Repository_reader::try_get_infos(const std::vector<Package_key>& keys, bool bypass_cache) -> std::vector<std::optional<Package_info>>
+    {
+        Cache_db db;
+        std::vector<std::optional<Package_info>> infos(keys.size());
+
+        auto store = [&](size_t i, const std::string& args, const Command_result& result) {
+            if (auto failure = classify_failure(result); failure != Failure_kind::none) {
+                std::cerr << "***conan inspect failed (" << failure_name(failure) << "): " << error_message(result) << std::endl;
+                return;
+            }
+            store_response(keys[i].remote, args, options.inspect_cache_ttl, result);
+            infos[i] = parse_inspect_output(result.output);
+        };
+
+        // From the cache, or by running conan, or (REST) in one batch per remote
+        std::map<Rest_client*, std::vector<size_t>> rest_batches;
+        for (auto i = 0U; i < keys.size(); i++) {
+            auto args = inspect_args(keys[i]);
+            std::cout << "INSPECT command: " << args << std::endl;
+            if (auto output = cached_response(db, keys[i].remote, args, options.inspect_cache_ttl, bypass_cache))
+                infos[i] = parse_inspect_output(*output);
+            else if (auto client = rest_client(keys[i].remote))
+                rest_batches[client].push_back(i);
+            else
+                store(i, args, call_remote(keys[i].remote, "inspect", [&]() { return run_conan(args); }));
+        }
+
+        // (The inspects of a batch that failed transiently are retried together)
+        for (auto& [client, indices]: rest_batches) {
+            auto& remote = keys[indices.front()].remote;
+            for (auto attempt = 1; !indices.empty(); attempt++) {
+                std::vector<Package_reference> references;
+                for (auto i: indices) references.push_back(keys[i].reference);
+                auto results = governor.call(remote, "inspect", static_cast<int>(indices.size()),
+                    [&]() { return client->inspect_all(references); });
+                std::vector<size_t> retries;
+                for (auto j = 0U; j < indices.size(); j++) {
+                    auto failure = classify_failure(results[j]);
+                    note_outcome(remote, failure, results[j]);
+                    if (failure == Failure_kind::transient && attempt < options.retry.max_attempts)
+                        retries.push_back(indices[j]);
+                    else
+                        store(indices[j], inspect_args(keys[indices[j]]), results[j]);
                 }
+                if (!retries.empty()) std::this_thread::sleep_for(options.retry.delay(attempt));
+                indices = std::move(retries);
             }
         }
 
-        fclose(file_ptr);
+        return infos;
+    }
+
+    auto Repository_reader::update_package_list(std::string_view remote, std::string_view pattern, int64_t scan_gen, bool bypass_cache) -> Search_outcome
+    {
+        // (The pattern is quoted so that the shell does not expand it)
+        auto args = std::format("search -r {} \"{}\" --raw", remote, pattern);
+        auto client = rest_client(remote);
+        auto result = run_conan_cached(remote, args, options.search_cache_ttl, bypass_cache, [&]() {
+            return call_remote(remote, "search", [&]() { return client ? client->search(pattern) : run_conan(args); });
+        });
+        auto failure = classify_failure(result);
+        if (failure != Failure_kind::none)
+            std::cerr << "***conan search failed (" << failure_name(failure) << "): " << error_message(result) << std::endl;
+
+        Search_outcome outcome{ .ok = failure == Failure_kind::none, .duration = result.duration, .failure = failure };
+        if (!outcome.ok) outcome.error = error_message(result);
+
+        auto re = std::regex("([^/]+)/([^@]+)(?:@([^/]+)/(.+))?");
+
+        std::vector<Package_reference> references;
+        for_each_line(result.output, [&](std::string_view line) {
+            std::string input{ line };
+            std::cout << input << std::endl;
+            std::smatch m;
+            if (std::regex_match(input, m, re)) {
+                std::cout << "Package name: " << m[1] << ", version: " << m[2] << ", user: " << m[3] << ", channel: " << m[4] << std::endl;
+                references.push_back({ .package = m[1].str(), .user = m[3].str(), .channel = m[4].str(), .version = m[2].str() });
+                ++outcome.results;
+            } else {
+                std::cerr << "***FAILED to parse package specifier \"" << input << "\"" << std::endl;
+                // (What this line stood for is unknown: the scan cannot be trusted to be complete)
+                if (outcome.ok) outcome = { .results = outcome.results, .duration = outcome.duration, .failure = Failure_kind::parse,
+                    .error = std::format("unexpected line \"{0}\"", input) };
+            }
+        });
+
+        // (The search only counts as completed once its packages are committed)
+        Cache_writer::instance().write([&](Cache_db& db) {
+            for (auto& reference: references)
+                db.upsert_package(remote, reference.package, reference.version, reference.user, reference.channel, scan_gen);
+            if (outcome.ok && scan_gen != 0)
+                db.mark_search_completed(scan_gen, pattern, { outcome.results, outcome.duration.count() / 1000 });
+        }).get();
+
+        return outcome;
+    }
+
+    auto Repository_reader::conan_command(std::string_view args) const -> std::string
+    {
+        return std::format("\"{0}\" {1}", options.conan_exe, args);
+    }
 
-        // database.set_package_info(pkg_id, info); // TODO: replace with Database::upsert()
+    auto Repository_reader::run_conan(std::string_view args) -> Command_result
+    {
+        if (replay) return replay->replay(args, options.replay_speed);
 
-        return info;
+        auto start = std::chrono::steady_clock::now();
+        auto result = run_command(conan_command(args), options.call_timeout);
+        if (recording) recording->record(args, result, start);
+        return result;
     }
 
-    void Repository_reader::update_package_list(std::string_view remote, std::string_view name_filter) 
+    // Collapses whitespace, so that equivalent command lines share their cache entry
+    static auto normalize_command_line(std::string_view args) -> std::string
     {
-        auto file_ptr = _popen(std::format("conan search -r {} {}* --raw", remote, name_filter).c_str(), "r");
-        if (!file_ptr) throw std::system_error(errno, std::generic_category());
+        std::string command;
+        for (auto ch: args) {
+            if (isspace(static_cast<unsigned char>(ch))) {
+                if (!command.empty() && command.back() != ' ') command += ' ';
+            }
+            else
+                command += ch;
+        }
+        if (!command.empty() && command.back() == ' ') command.pop_back();
+        return command;
+    }
 
+    auto Repository_reader::run_conan_cached(std::string_view remote, std::string_view args, int64_t ttl, bool bypass_cache,
+        const std::function<Command_result()>& fetch) -> Command_result
+    {
         Cache_db db;
 
-        auto re = std::regex("([^/]+)/([^@]+)(?:@([^/]+)/(.+))?");
+        if (auto output = cached_response(db, remote, args, ttl, bypass_cache))
+            return Command_result{ .output = std::move(*output) };
 
-        while (!feof(file_ptr)) {
-            char buffer[1024];
-            if (fgets(buffer, sizeof(buffer), file_ptr)) {
-                std::string input = buffer;
-                input.erase(std::remove(input.begin(), input.end(), '\n'), input.end());
-                std::cout << input << std::endl;
-                std::smatch m;
-                if (std::regex_match(input, m, re)) {
-                    std::cout << "Package name: " << m[1] << ", version: " << m[2] << ", user: " << m[3] << ", channel: " << m[4] << std::endl;
-                    db.upsert_package(remote, m[1].str(), m[2].str(), m[3].str(), m[4].str());
-                } else {
-                    std::cerr << "***FAILED to parse package specifier \"" << input << "\"" << std::endl;
-                }
+        auto result = fetch ? fetch() : run_conan(args);
+        store_response(remote, args, ttl, result);
+        return result;
+    }
+
+    auto Repository_reader::call_remote(std::string_view remote, std::string_view operation, const std::function<Command_result()>& fetch) -> Command_result
+    {
+        for (auto attempt = 1;; attempt++) {
+            auto result = governor.call(remote, operation, 1, fetch);
+            auto failure = classify_failure(result);
+            note_outcome(remote, failure, result);
+            if (failure != Failure_kind::transient || attempt >= options.retry.max_attempts) return result;
+
+            auto delay = options.retry.delay(attempt);
+            std::cerr << std::format("***{0} on {1} failed (attempt {2}), retrying in {3} ms: {4}",
+                operation, remote, attempt, delay.count(), error_message(result)) << std::endl;
+            std::this_thread::sleep_for(delay);
+        }
+    }
+
+    void Repository_reader::note_outcome(std::string_view remote, Failure_kind failure, const Command_result& result)
+    {
+        // A missing package does not make the remote unhealthy; only changes of health are written
+        auto healthy = failure == Failure_kind::none || failure == Failure_kind::not_found;
+        {
+            auto lock = std::unique_lock{failure_mutex};
+            auto it = failing_remotes.find(remote);
+            if (healthy && it == failing_remotes.end()) return;
+            if (healthy)
+                failing_remotes.erase(it);
+            else if (it == failing_remotes.end())
+                failing_remotes.emplace(remote);
+        }
+
+        // (Nothing waits for it)
+        Cache_writer::instance().write([remote = std::string{ remote }, healthy, failure, error = error_message(result)](Cache_db& db) {
+            if (healthy)
+                db.record_remote_success(remote);
+            else
+                db.record_remote_failure(remote, failure_name(failure), error);
+            db.record_remote_health(remote, healthy);
+        });
+    }
+
+    auto Repository_reader::cached_response(Cache_db& db, std::string_view remote, std::string_view args, int64_t ttl, bool bypass_cache) -> std::optional<std::string>
+    {
+        // A recording must contain every invocation, and a replay must not be short-circuited
+        if (ttl <= 0 || recording || replay) return {};
+
+        if (bypass_cache) {
+            ++cache_bypassed;
+            return {};
+        }
+        auto output = db.get_response(remote, normalize_command_line(args), ttl);
+        ++(output ? cache_hits : cache_misses);
+        return output;
+    }
+
+    void Repository_reader::store_response(std::string_view remote, std::string_view args, int64_t ttl, const Command_result& result)
+    {
+        if (ttl <= 0 || recording || replay || result.exit_code != 0) return;
+
+        // (Written behind: until it is committed, the same call is just made again)
+        Cache_writer::instance().write([remote = std::string{ remote }, command = normalize_command_line(args), output = result.output](Cache_db& db) {
+            db.store_response(remote, command, output);
+        });
+    }
+
+    auto Repository_reader::rest_client(std::string_view remote) -> Rest_client*
+    {
+        if (!options.use_rest_api || recording || replay) return nullptr;
+
+        auto lock = std::unique_lock{rest_mutex};
+        auto it = rest_clients.find(remote);
+        if (it == rest_clients.end()) {
+            auto url = remote_url(remote);
+            if (!url) return nullptr;
+            it = rest_clients.emplace(std::string{ remote }, std::make_unique<Rest_client>(*url, options.rest_connections, options.call_timeout)).first;
+        }
+        return it->second.get();
+    }
+
+    void Repository_reader::refresh_remotes()
+    {
+        try {
+            // conan's own files are read rather than running it, except when the session is recorded or
+            // replayed (the archive must have the "remote list" invocation)
+            std::vector<Remote_entry> list;
+            if (!recording && !replay)
+                list = read_remote_files(options.conan_homes.empty() ? default_conan_homes() : options.conan_homes);
+            if (list.empty()) {
+                auto result = run_conan("remote list");
+                if (result.exit_code != 0) throw std::runtime_error(std::format("conan remote list failed: {0}", error_message(result)));
+                list = parse_remote_list(result.output);
+            }
+
+            if (!recording && !replay) {
+                list = Cache_writer::instance().write([&](Cache_db& db) {
+                    db.replace_remotes(list);
+                    return db.get_remotes();    // (with their last known health)
+                }).get();
+            }
+            {
+                auto lock = std::unique_lock{remotes_mutex};
+                remote_list = list;
+                remotes_known = true;
+            }
+            remotes_cv.notify_all();
+
+            // Health check of the enabled remotes (without going through conan, that would mean a search)
+            if (!options.use_rest_api || recording || replay) return;
+            for (auto& remote: list) {
+                if (!remote.enabled) continue;
+                auto client = rest_client(remote.name);
+                if (!client) continue;
+                auto response = client->get("/v1/ping");
+                Cache_writer::instance().write([name = remote.name, healthy = response.status >= 200 && response.status < 300](Cache_db& db) {
+                    db.record_remote_health(name, healthy);
+                });
+            }
+        }
+        catch (const std::exception& e) {
+            std::cerr << "***Unable to refresh the remote list: " << e.what() << std::endl;
+            {
+                auto lock = std::unique_lock{remotes_mutex};
+                remotes_known = true;
             }
+            remotes_cv.notify_all();
         }
+    }
+
+    auto Repository_reader::remotes() -> std::vector<Remote_entry>
+    {
+        auto lock = std::unique_lock{remotes_mutex};
+        remotes_cv.wait(lock, [this]() { return remotes_known; });
+        return remote_list;
+    }
+
+    auto Repository_reader::remote_url(std::string_view remote) -> std::optional<std::string>
+    {
+        for (auto& entry: remotes())
+            if (entry.name == remote) return entry.url;
+        return {};
+    }
 
-        fclose(file_ptr);
+    auto Repository_reader::response_cache_stats() const -> Response_cache_stats
+    {
+        return { cache_hits.load(), cache_misses.load(), cache_bypassed.load() };
+    }
+
+    auto Repository_reader::remote_limits() -> std::vector<Remote_limits>
+    {
+        return governor.limits();
+    }
+
+    void Repository_reader::invalidate_response_cache(std::string_view remote)
+    {
+        auto count = Cache_writer::instance().write([remote = std::string{ remote }](Cache_db& db) { return db.invalidate_responses(remote); }).get();
+        std::cout << "Response cache: " << count << " entries invalidated" << std::endl;
     }
 
-} // Conan
+} // Conan
\ No newline at end of file
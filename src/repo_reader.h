@@ -1,23 +1,73 @@
 #pragma once
 
+#include <string>
 #include <string_view>
 #include <queue>
 #include <mutex>
 #include <future>
-#include "./async_data.h"
+#include <optional>
+#include <map>
+#include <vector>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <set>
+#include <condition_variable>
+#include <filesystem>
+#include "./command_runner.h"
+#include "./command_archive.h"
+#include "./remote_errors.h"
+#include "./remote_governor.h"
+#include "./rest_client.h"
 #include "./types.h"
-#include "./sqlite_wrapper/database.h"
+#include "./cache_db.h"
 
 
 namespace Conan {
 
+    struct Reader_options {
+        std::string conan_exe = "conan";    // can be a stand-in like tools/fake_conan
+        std::string record_file;            // if set, record all conan invocations into this archive
+        std::string replay_file;            // if set, replay conan invocations from this archive instead of running conan
+        double      replay_speed = 1;       // 1 = original timing, 0 = as fast as possible
+        int64_t     split_threshold = 2000; // name prefixes whose last search returned more packages are split
+        size_t      max_prefix_length = 3;  // ... but not beyond this length
+        unsigned    parallel_searches = 4;  // concurrent conan searches during a scan
+        int64_t     search_cache_ttl = 3600;    // seconds during which "conan search" responses are reused (0 = never)
+        int64_t     inspect_cache_ttl = 86400;  // same for "conan inspect"
+        bool        use_rest_api = false;   // search and inspect through the REST API of the remotes instead of running conan
+        unsigned    rest_connections = 4;   // per remote
+        Governor_options governor;          // rate and concurrency of the calls to each remote (not applied when replaying)
+        std::chrono::seconds call_timeout{ 120 };   // conan commands and REST requests running longer are killed
+        Retry_policy retry;                 // for transient failures
+        std::vector<std::filesystem::path> conan_homes;  // where to read the remote list from (empty = conan's defaults)
+    };
+
+    struct Response_cache_stats {
+        int64_t     hits = 0;
+        int64_t     misses = 0;
+        int64_t     bypassed = 0;   // forced re-queries
+    };
+
+    struct Letter_scan_result {
+        std::vector<Package_list_entry>     removed;
+        std::map<std::string, std::string>  failures;   // remotes that could not be read completely, and why
+        int64_t                             resumed = 0;    // searches that an interrupted scan had completed
+    };
+
     class Repository_reader {
     public:
         
-        explicit Repository_reader(); // SQLite::Database& db);
+        explicit Repository_reader(Reader_options = {}); // SQLite::Database& db);
+
+        // Returns false if conan failed (the packages read, if any, are still stored)
+        bool filtered_read(std::string_view repo, std::string_view name_filter, int64_t scan_gen = 0);
 
-        void filtered_read(std::string_view repo, std::string_view name_filter);
-        void read_letter_all_repositories(char first_letter);
+        // Heavy letters are searched by sub-prefixes (according to the statistics of the previous scans), in
+        // parallel. Purges the packages that a remote no longer has (if that remote could be read completely),
+        // and returns them. The scan of a remote that failed resumes with its missing searches the next time
+        // (unless bypass_cache is set).
+        auto read_letter_all_repositories(char first_letter, bool bypass_cache = false) -> Letter_scan_result;
 
         // auto get_info(
         //     std::string_view remote, 
@@ -27,19 +77,96 @@ namespace Conan {
         //     std::string_view version
         // ) -> Package_info;
 
-        auto get_info(const Package_key&) -> Package_info;
+        auto get_info(const Package_key&, bool bypass_cache = false) -> Package_info;
+        auto try_get_info(const Package_key&, bool bypass_cache = false) -> std::optional<Package_info>;  // empty if conan failed
+
+        // Over the REST API, the packages of a remote are inspected concurrently
+        auto try_get_infos(const std::vector<Package_key>&, bool bypass_cache = false) -> std::vector<std::optional<Package_info>>;
+
+        // Responses of conan searches and inspects are memoized in the cache database (not while recording or
+        // replaying a session); bypass_cache forces conan to be run, and its response to be stored again.
+        auto response_cache_stats() const -> Response_cache_stats;
+        void invalidate_response_cache(std::string_view remote = {});  // all remotes if empty
+
+        // The remotes, by priority (enabled or not). Those of the previous session are available right away,
+        // from the cache database, while the list is refreshed in the background; the very first time, this
+        // waits for the refresh.
+        auto remotes() -> std::vector<Remote_entry>;
+
+        // Current limits of the calls to the remotes that have been called so far
+        auto remote_limits() -> std::vector<Remote_limits>;
 
     private:
 
-        void update_package_list(std::string_view remote, std::string_view name_filter);
+        struct Search_outcome {
+            bool                        ok = false;
+            int64_t                     results = 0;
+            std::chrono::microseconds   duration{};
+            Failure_kind                failure = Failure_kind::none;
+            std::string                 error;
+        };
+
+        // One search of a letter scan: all names starting with the prefix, or (exact) just the name equal to it
+        struct Name_search {
+            std::string prefix;
+            bool        exact = false;
+
+            auto pattern() const -> std::string { return exact ? prefix : prefix + "*"; }
+        };
+
+        auto update_package_list(std::string_view remote, std::string_view pattern, int64_t scan_gen, bool bypass_cache = false) -> Search_outcome;
+
+        void plan_searches(const std::string& prefix, const std::map<std::string, int64_t>& results, std::vector<Name_search>&) const;
+
+        auto conan_command(std::string_view args) const -> std::string;
+
+        // Runs conan with the given arguments (or replays a recorded invocation)
+        auto run_conan(std::string_view args) -> Command_result;
+
+        // Same, through the response cache; "fetch" can get the response by other means than running conan
+        auto run_conan_cached(std::string_view remote, std::string_view args, int64_t ttl, bool bypass_cache,
+            const std::function<Command_result()>& fetch = {}) -> Command_result;
+
+        // Calls a remote through the governor, retrying transient failures; records the health of the remote
+        auto call_remote(std::string_view remote, std::string_view operation, const std::function<Command_result()>& fetch) -> Command_result;
+        void note_outcome(std::string_view remote, Failure_kind, const Command_result&);
+
+        // Response cache lookup (if the cache is in use) and update
+        auto cached_response(Cache_db&, std::string_view remote, std::string_view args, int64_t ttl, bool bypass_cache) -> std::optional<std::string>;
+        void store_response(std::string_view remote, std::string_view args, int64_t ttl, const Command_result&);
+
+        static auto inspect_args(const Package_key&) -> std::string;
+
+        // Reads the remote list from conan's files (or, failing that, from "conan remote list"), stores it, and
+        // checks the health of the remotes if the REST API is in use
+        void refresh_remotes();
+        auto remote_url(std::string_view remote) -> std::optional<std::string>;
+
+        // REST client of a remote; null if the REST API is not used (it never is while recording or replaying)
+        auto rest_client(std::string_view remote) -> Rest_client*;
+
+        Reader_options              options;
+        std::optional<Command_archive> recording, replay;
+        Remote_governor             governor;
+        std::mutex                  failure_mutex;
+        std::set<std::string, std::less<>> failing_remotes;    // whose last call failed (as recorded in the database)
+        std::atomic<int64_t>        cache_hits = 0, cache_misses = 0, cache_bypassed = 0;
 
         // SQLite::Database&           database;
 
-        async_data<std::vector<std::string>> remotes_ad;
+        std::mutex                  remotes_mutex;
+        std::condition_variable     remotes_cv;
+        std::vector<Remote_entry>   remote_list;
+        bool                        remotes_known = false;
+
+        std::mutex                  rest_mutex;
+        std::map<std::string, std::unique_ptr<Rest_client>, std::less<>> rest_clients;
 
         std::thread                 reader_thread;
         std::condition_variable     reader_cv;
         bool                        term_flag = false;
+
+        std::future<void>           remotes_refresh;    // (last, so that it is waited for first on destruction)
     };
 
 } // ns Conan
\ No newline at end of file
@@ -0,0 +1,259 @@
+#include <iostream>
+#include <mutex>
+#include <regex>
+#include <stdexcept>
+#include <format>
+#include <curl/curl.h>
+#include <nlohmann/json.hpp>
+#include "./conan_metadata.h"
+#include "./rest_client.h"
+
+
+namespace Conan {
+
+    static auto write_callback(char* data, size_t size, size_t count, void* user_data) -> size_t
+    {
+        static_cast<std::string*>(user_data)->append(data, size * count);
+        return size * count;
+    }
+
+    static auto url_encode(std::string_view text) -> std::string
+    {
+        static constexpr std::string_view hex_digits = "0123456789ABCDEF";
+
+        std::string out;
+        for (unsigned char ch: text) {
+            if (isalnum(ch) || ch == '-' || ch == '_' || ch == '.' || ch == '~')
+                out += static_cast<char>(ch);
+            else
+                out += { '%', hex_digits[ch >> 4], hex_digits[ch & 15] };
+        }
+        return out;
+    }
+
+    Rest_client::Rest_client(std::string base_url_, unsigned max_connections_, std::chrono::milliseconds timeout_):
+        base_url{std::move(base_url_)},
+        max_connections{std::max(1U, max_connections_)},
+        timeout{timeout_}
+    {
+        static std::once_flag global_init;
+        std::call_once(global_init, []() { curl_global_init(CURL_GLOBAL_DEFAULT); });
+
+        while (!base_url.empty() && base_url.back() == '/') base_url.pop_back();
+
+        share = curl_share_init();
+        curl_share_setopt(share, CURLSHOPT_LOCKFUNC, +[](CURL*, curl_lock_data data, curl_lock_access, void* user_data) {
+            static_cast<Rest_client*>(user_data)->share_mutexes[data % 16].lock();
+        });
+        curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, +[](CURL*, curl_lock_data data, void* user_data) {
+            static_cast<Rest_client*>(user_data)->share_mutexes[data % 16].unlock();
+        });
+        curl_share_setopt(share, CURLSHOPT_USERDATA, this);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+    }
+
+    Rest_client::~Rest_client()
+    {
+        for (auto handle: idle_handles) curl_easy_cleanup(handle);
+        curl_share_cleanup(share);
+    }
+
+    auto Rest_client::new_handle(std::string_view path, std::string& body) -> CURL*
+    {
+        auto handle = curl_easy_init();
+        if (!handle) throw std::runtime_error("curl_easy_init() failed");
+        curl_easy_setopt(handle, CURLOPT_SHARE, share);
+        curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1L);
+        curl_easy_setopt(handle, CURLOPT_TCP_KEEPALIVE, 1L);
+        curl_easy_setopt(handle, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+        curl_easy_setopt(handle, CURLOPT_PIPEWAIT, 1L);    // rather multiplex over an HTTP/2 connection than open another one
+        curl_easy_setopt(handle, CURLOPT_ACCEPT_ENCODING, "");
+        curl_easy_setopt(handle, CURLOPT_FOLLOWLOCATION, 1L);
+        curl_easy_setopt(handle, CURLOPT_CONNECTTIMEOUT, 10L);
+        curl_easy_setopt(handle, CURLOPT_TIMEOUT_MS, static_cast<long>(timeout.count()));
+        curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, write_callback);
+        curl_easy_setopt(handle, CURLOPT_URL, (base_url + std::string{ path }).c_str());
+        curl_easy_setopt(handle, CURLOPT_WRITEDATA, &body);
+        return handle;
+    }
+
+    auto Rest_client::acquire_handle() -> CURL*
+    {
+        auto lock = std::unique_lock{mutex};
+        handle_cv.wait(lock, [this]() { return !idle_handles.empty() || handle_count < max_connections; });
+        if (!idle_handles.empty()) {
+            auto handle = idle_handles.back();
+            idle_handles.pop_back();
+            return handle;
+        }
+        ++handle_count;
+        return nullptr; // caller creates it
+    }
+
+    void Rest_client::release_handle(CURL* handle)
+    {
+        auto lock = std::unique_lock{mutex};
+        idle_handles.push_back(handle);
+        handle_cv.notify_one();
+    }
+
+    auto Rest_client::get(std::string_view path) -> Http_response
+    {
+        Http_response response;
+
+        auto handle = acquire_handle();
+        if (!handle)
+            handle = new_handle(path, response.body);
+        else {
+            curl_easy_setopt(handle, CURLOPT_URL, (base_url + std::string{ path }).c_str());
+            curl_easy_setopt(handle, CURLOPT_WRITEDATA, &response.body);
+        }
+
+        if (auto code = curl_easy_perform(handle); code != CURLE_OK) {
+            response.error = curl_easy_strerror(code);
+            response.timed_out = code == CURLE_OPERATION_TIMEDOUT;
+        }
+        else
+            curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &response.status);
+
+        release_handle(handle);
+        return response;
+    }
+
+    auto Rest_client::get_all(const std::vector<std::string>& paths) -> std::vector<Http_response>
+    {
+        std::vector<Http_response> responses(paths.size());
+
+        auto multi = curl_multi_init();
+        curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+        curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, static_cast<long>(max_connections));
+
+        std::vector<CURL*> handles;
+        for (auto i = 0U; i < paths.size(); i++) {
+            auto handle = new_handle(paths[i], responses[i].body);
+            curl_easy_setopt(handle, CURLOPT_PRIVATE, &responses[i]);
+            curl_multi_add_handle(multi, handle);
+            handles.push_back(handle);
+        }
+
+        for (int running = 1; running;) {
+            if (auto code = curl_multi_perform(multi, &running); code != CURLM_OK) {
+                for (auto& response: responses)
+                    if (response.status == 0 && response.error.empty()) response.error = curl_multi_strerror(code);
+                break;
+            }
+            for (int queued; auto message = curl_multi_info_read(multi, &queued);) {
+                if (message->msg != CURLMSG_DONE) continue;
+                Http_response* response = nullptr;
+                curl_easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, &response);
+                if (message->data.result != CURLE_OK) {
+                    response->error = curl_easy_strerror(message->data.result);
+                    response->timed_out = message->data.result == CURLE_OPERATION_TIMEDOUT;
+                }
+                else
+                    curl_easy_getinfo(message->easy_handle, CURLINFO_RESPONSE_CODE, &response->status);
+            }
+            if (running) curl_multi_poll(multi, nullptr, 0, 1000, nullptr);
+        }
+
+        for (auto handle: handles) {
+            curl_multi_remove_handle(multi, handle);
+            curl_easy_cleanup(handle);
+        }
+        curl_multi_cleanup(multi);
+
+        return responses;
+    }
+
+    auto Rest_client::reference_path(const Package_reference& reference) -> std::string
+    {
+        return std::format("/v2/conans/{0}/{1}/{2}/{3}", reference.package, reference.version,
+            reference.user.empty() ? "_" : reference.user, reference.channel.empty() ? "_" : reference.channel);
+    }
+
+    // Failed requests are reported like failed conan commands
+    static auto failure(const Http_response& response, std::string_view what) -> Command_result
+    {
+        Command_result result;
+        result.exit_code = 1;
+        result.errors = response.status == 0
+            ? std::format("ERROR: {0}: {1}", what, response.error)
+            : std::format("ERROR: {0}: HTTP {1}", what, response.status);
+        result.timed_out = response.timed_out;
+        return result;
+    }
+
+    auto Rest_client::search(std::string_view pattern) -> Command_result
+    {
+        auto start = std::chrono::steady_clock::now();
+        auto response = get(std::format("/v2/conans/search?q={0}&ignorecase=True", url_encode(pattern)));
+        if (!response.ok()) return failure(response, "search");
+
+        Command_result result;
+        try {
+            // Servers may return references without user/channel as "name/version@_/_"
+            auto json = nlohmann::json::parse(response.body);
+            for (auto& reference: json.at("results")) {
+                auto text = reference.get<std::string>();
+                if (text.ends_with("@_/_")) text.resize(text.size() - 4);
+                result.output += text + '\n';
+            }
+        }
+        catch (const nlohmann::json::exception& e) {
+            return failure(Http_response{ 0, {}, std::format("unexpected response: {0}", e.what()) }, "search");
+        }
+        result.duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+        return result;
+    }
+
+    auto Rest_client::inspect(const Package_reference& reference) -> Command_result
+    {
+        return inspect_all({ reference }).front();
+    }
+
+    auto Rest_client::inspect_all(const std::vector<Package_reference>& references) -> std::vector<Command_result>
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<Command_result> results(references.size());
+
+        // Latest recipe revisions, then the conanfiles of those revisions
+        std::vector<std::string> paths;
+        for (auto& reference: references)
+            paths.push_back(reference_path(reference) + "/latest");
+        auto revisions = get_all(paths);
+
+        paths.clear();
+        std::vector<size_t> indices;
+        for (auto i = 0U; i < references.size(); i++) {
+            if (!revisions[i].ok()) {
+                results[i] = failure(revisions[i], "inspect");
+                continue;
+            }
+            try {
+                auto revision = nlohmann::json::parse(revisions[i].body).at("revision").get<std::string>();
+                paths.push_back(std::format("{0}/revisions/{1}/files/conanfile.py", reference_path(references[i]), revision));
+                indices.push_back(i);
+            }
+            catch (const nlohmann::json::exception& e) {
+                results[i] = failure(Http_response{ 0, {}, std::format("unexpected response: {0}", e.what()) }, "inspect");
+            }
+        }
+        auto conanfiles = get_all(paths);
+
+        auto duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+        for (auto j = 0U; j < indices.size(); j++) {
+            auto& result = results[indices[j]];
+            if (!conanfiles[j].ok())
+                result = failure(conanfiles[j], "inspect");
+            else {
+                result.output = conanfile_inspect_output(conanfiles[j].body);
+                result.duration = duration;
+            }
+        }
+
+        return results;
+    }
+
+} // ns Conan
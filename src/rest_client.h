@@ -0,0 +1,74 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "./command_runner.h"
+#include "./types.h"
+
+
+typedef void CURL;
+typedef void CURLSH;
+
+namespace Conan {
+
+    struct Http_response {
+        long        status = 0;     // 0 if the request did not get through
+        std::string body;
+        std::string error;          // transport error
+        bool        timed_out = false;
+
+        bool ok() const { return status == 200; }
+    };
+
+    /**
+     * Client for the REST API (v2) of a Conan server, i.e. of one remote.
+     *
+     * Connections are kept alive and shared by all requests (DNS, TLS sessions and connections are in a
+     * curl share). get() can be called from several threads at once, using up to max_connections
+     * connections; get_all() runs a batch of requests concurrently over the same connections, multiplexed
+     * if the server speaks HTTP/2.
+     *
+     * search() and inspect() return what the equivalent "conan search --raw" and "conan inspect" commands
+     * print, so that their responses can be parsed and cached the same way; failures are reported like those
+     * of conan too ("ERROR: ...", with the HTTP status), so that they are classified the same way.
+     */
+    class Rest_client {
+    public:
+        explicit Rest_client(std::string base_url, unsigned max_connections = 4, std::chrono::milliseconds timeout = std::chrono::seconds{ 60 });
+        ~Rest_client();
+
+        Rest_client(const Rest_client&) = delete;
+        Rest_client& operator = (const Rest_client&) = delete;
+
+        auto get(std::string_view path) -> Http_response;
+        auto get_all(const std::vector<std::string>& paths) -> std::vector<Http_response>;
+
+        auto search(std::string_view pattern) -> Command_result;
+        auto inspect(const Package_reference&) -> Command_result;
+        auto inspect_all(const std::vector<Package_reference>&) -> std::vector<Command_result>;
+
+    private:
+
+        static auto reference_path(const Package_reference&) -> std::string;
+
+        auto acquire_handle() -> CURL*;
+        void release_handle(CURL*);
+        auto new_handle(std::string_view path, std::string& body) -> CURL*;
+
+        std::string                 base_url;
+        unsigned                    max_connections;
+        std::chrono::milliseconds   timeout;        // of each request
+        CURLSH*                     share = nullptr;
+        std::array<std::mutex, 16>  share_mutexes;  // by curl_lock_data
+        std::mutex                  mutex;
+        std::condition_variable     handle_cv;
+        std::vector<CURL*>          idle_handles;
+        unsigned                    handle_count = 0;
+    };
+
+} // ns Conan
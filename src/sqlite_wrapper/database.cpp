@@ -1,10 +1,12 @@
 #include <cassert>
+#include <cctype>
 #include <string>
 #include <cstdlib>
 #include <iostream>
 #include <stdexcept>
 #include <filesystem>
 #include <algorithm>
+#include <atomic>
 #include <concepts>
 #include <format>
 
@@ -22,10 +24,10 @@ std::string replace_string(std::string subject, const std::string& search, const
 
 namespace SQLite {
 
-    class sqlite_error: public std::exception {
+    class sqlite_error: public std::runtime_error {
     public:
         explicit sqlite_error(sqlite3* db, int code, /* const char* err_msg = nullptr, */ std::string_view context = ""):
-            exception(make_message(db, code, /* err_msg, */ context).c_str())
+            runtime_error(make_message(db, code, /* err_msg, */ context))
         {}
     private:
         static auto make_message(sqlite3* db, int code, /* const char* err_msg, */ std::string_view context) -> std::string {
@@ -38,7 +40,39 @@ namespace SQLite {
     };
 
 
-    Database::Database(const char *filename)
+    static std::atomic<int64_t> statement_hits = 0, statement_misses = 0, statement_evictions = 0;
+
+    auto statement_cache_stats() -> Statement_cache_stats
+    {
+        return { statement_hits.load(), statement_misses.load(), statement_evictions.load() };
+    }
+
+    Cached_statement::Cached_statement(Cached_statement&& other) noexcept:
+        database{other.database}, stmt{other.stmt}, cached{other.cached}
+    {
+        other.stmt = nullptr;
+    }
+
+    auto Cached_statement::operator = (Cached_statement&& other) noexcept -> Cached_statement&
+    {
+        if (this != &other) {
+            if (stmt) database->give_back(stmt, cached);
+            database = other.database;
+            stmt = other.stmt;
+            cached = other.cached;
+            other.stmt = nullptr;
+        }
+        return *this;
+    }
+
+    Cached_statement::~Cached_statement()
+    {
+        if (stmt) database->give_back(stmt, cached);
+    }
+
+
+    Database::Database(const char *filename, size_t statement_cache_capacity):
+        statement_capacity{statement_cache_capacity}
     {
         using namespace std::filesystem;
 
@@ -46,28 +80,33 @@ namespace SQLite {
 
         auto db_err = sqlite3_open_v2(filename, &db_handle, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_FULLMUTEX, nullptr);
         if (db_err != SQLITE_OK) throw sqlite_error(db_handle, db_err, "trying to open/create database");
+
+        // Every background task has its own connection: wait for the others' write locks instead of failing
+        sqlite3_busy_timeout(db_handle, 10000);
     }
 
     Database::~Database()
     {
+        for (auto& entry: statements)
+            sqlite3_finalize(entry.stmt);
         if (db_handle != nullptr)
             sqlite3_close(db_handle);
     }
 
     auto Database::query_single_row(const char *list_query, const char *context) -> std::vector<std::string>
     {
-        char *errmsg;
-        int dberr;
-
         std::vector<std::string> output;
 
-        dberr = sqlite3_exec(db_handle, list_query, [](void* out_, int coln, char* textv[], char* namev[]) -> int {
-            auto& pout = *static_cast<decltype(output)*>(out_);
-            for (auto i = 0; i < coln; i ++) pout.push_back(textv[i]);
-            return 0;
-        }, &output, &errmsg);
-
-        if (dberr != 0) throw sqlite_error(db_handle, dberr, context);
+        auto stmt = cached_statement(list_query, context ? context : "");
+        auto err = stmt ? sqlite3_step(stmt) : SQLITE_MISUSE;
+        if (err == SQLITE_ROW) {
+            for (auto i = 0; i < sqlite3_column_count(stmt); i++) {
+                auto text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, i));
+                output.push_back(text ? text : "");
+            }
+        }
+        else if (err != SQLITE_DONE)
+            throw sqlite_error(db_handle, err, context ? context : "");
 
         return output;
     }
@@ -84,12 +123,16 @@ namespace SQLite {
 
     void Database::select(const char *statement, select_callback cb)
     {
-        char* errmsg;
-        auto db_err = sqlite3_exec(db_handle, statement, [](void* data, int coln, char* textv[], char* namev[]) -> int {
-            select_callback& cb = *static_cast<select_callback*>(data);
-            return cb(coln, (const char * const *)textv, (const char * const *)namev);
-        }, &cb, &errmsg);
-        if (db_err != 0) throw sqlite_error(db_handle, db_err, errmsg);
+        auto stmt = cached_statement(statement);
+        if (!stmt) throw std::runtime_error(std::format("select() takes a single statement: {0}", statement));
+
+        auto col_count = sqlite3_column_count(stmt);
+        std::vector<const char*> values(col_count), names(col_count);
+        for (auto i = 0; i < col_count; i++) names[i] = sqlite3_column_name(stmt, i);
+        while (execute(stmt)) {
+            for (auto i = 0; i < col_count; i++) values[i] = reinterpret_cast<const char*>(sqlite3_column_text(stmt, i));
+            if (cb(col_count, values.data(), names.data()) != 0) break;
+        }
     }
 
     auto Database::select(
@@ -100,57 +143,34 @@ namespace SQLite {
         std::initializer_list<std::string_view> params
     ) -> Rows
     {
-        using namespace std::string_literals;
-
         auto statement = std::format("SELECT {0} FROM {1}", join_strings(columns), table);
         if (!where_clause.empty()) statement += std::format(" WHERE {0}", where_clause);
         if (!order_by_clause.empty()) statement += std::format(" ORDER BY {0}", order_by_clause);
 
-        // Prepare the statement
-        sqlite3_stmt* stmt = nullptr;
-        auto err = sqlite3_prepare_v2(db_handle, statement.c_str(), -1, &stmt, nullptr);
-        if (err != SQLITE_OK) throw sqlite_error(db_handle, err, "trying to prepare statement: "s + statement);
+        auto stmt = cached_statement(statement, std::format("trying to prepare statement: {0}", statement));
 
-        // Bind the parameters
-        for (auto i = 0U; auto& param: params) {
-            err = sqlite3_bind_text(stmt, i, param.data(), param.size(), nullptr);
+        // Bind the parameters (numbered from 1)
+        for (auto i = 1; auto& param: params) {
+            auto err = sqlite3_bind_text(stmt, i++, param.data(), static_cast<int>(param.size()), SQLITE_TRANSIENT);
             if (err != SQLITE_OK) throw sqlite_error(db_handle, err, "trying to bind value to prepared statement");
-            i ++;
         }
 
         // Execute the statement and collect the rows
         Rows rows;
-        if (err != SQLITE_DONE) throw sqlite_error(db_handle, err, "trying to execute prepared statement upsert_package_info");
-        do {
-            err  = sqlite3_step(stmt);
-            if (err == SQLITE_ROW) {
-                Row row;
-                for (auto i = 0U; const auto col_name: columns) {
-                    auto type = sqlite3_column_decltype(stmt, i);
-                    if ("INTEGER"s == type) // type if (type == SQLITE_INTEGER)
-                        row.emplace_back(Value{ sqlite3_column_int64(stmt, i) });
-                    else if ("FLOAT"s == type) // if (type == SQLITE_FLOAT)
-                        row.emplace_back(Value{ sqlite3_column_double(stmt, i) });
-                    else if ("TEXT"s == type) // if (type == SQLITE_TEXT)
-                        row.emplace_back(Value{ (const char *)sqlite3_column_text(stmt, i) });
-                    else
-                        row.emplace_back(Value{});
-                }
-                rows.push_back(row);
-            }
-        } while (err != SQLITE_ERROR && err != SQLITE_DONE && err != SQLITE_MISUSE);
+        for (int err; (err = sqlite3_step(stmt)) != SQLITE_DONE;) {
+            if (err != SQLITE_ROW) throw sqlite_error(db_handle, err, std::format("trying to execute statement: {0}", statement));
+            rows.push_back(get_row(stmt));
+        }
 
         return rows;
     }
 
     auto Database::select_one(std::string_view statement, const std::initializer_list<Value> keys) -> Row
     {
-        auto stmt = prepare_statement(statement);
-        if (!execute(stmt, keys))
+        auto stmt = cached_statement(statement);
+        if (!stmt || !execute(stmt, keys))
             throw std::runtime_error("expected statement to return at least one row but it returned none");
-        auto row = get_row(stmt);
-        sqlite3_reset(stmt);
-        return row;
+        return get_row(stmt);
     }
 
     auto Database::get_row_id(std::string_view table, std::string_view where_clause) -> int64_t
@@ -217,19 +237,24 @@ namespace SQLite {
         sqlite3_stmt* stmt = nullptr;
         auto err = sqlite3_prepare_v2(db_handle, statement.data(), statement.size(), &stmt, nullptr);
         if (err != SQLITE_OK) throw sqlite_error(db_handle, err, "trying to prepare statement");
+        if (stmt) register_columns(stmt);
         return stmt;
     }
 
     bool Database::execute(sqlite3_stmt* stmt, std::initializer_list<Value> values)
     {
         if (sqlite3_stmt_busy(stmt) == 0) {
-            // Bind the parameters
+            // A statement that ran to completion must be reset before it can be bound again
+            sqlite3_reset(stmt);
+            // Bind the parameters (strings and blobs are copied: the values are usually temporaries that are
+            // gone by the time the statement is stepped again)
             for (auto i = 1U; auto & param: values) {
                 int err = 0;
                 if      (param.index() == 0) err = sqlite3_bind_null  (stmt, i);
                 else if (param.index() == 1) err = sqlite3_bind_int64 (stmt, i, std::get<1>(param));
                 else if (param.index() == 2) err = sqlite3_bind_double(stmt, i, std::get<2>(param));
-                else if (param.index() == 3) err = sqlite3_bind_text  (stmt, i, std::get<3>(param).data(), std::get<3>(param).size(), nullptr);
+                else if (param.index() == 3) err = sqlite3_bind_text  (stmt, i, std::get<3>(param).data(), std::get<3>(param).size(), SQLITE_TRANSIENT);
+                else if (param.index() == 4) err = sqlite3_bind_blob  (stmt, i, std::get<4>(param).data(), std::get<4>(param).size(), SQLITE_TRANSIENT);
                 ++i;
                 assert(err >= 0);
             }
@@ -244,49 +269,184 @@ namespace SQLite {
 
     void Database::execute(std::string_view statement, std::string_view context)
     {
-        int db_err;
+        // Scripts (several statements, e.g. schema updates) run once: they go through sqlite3_exec()
+        auto stmt = cached_statement(statement, context);
+        if (!stmt) {
+            auto db_err = sqlite3_exec(db_handle, std::string{statement}.c_str(), nullptr, nullptr, nullptr);
+            if (db_err != 0) throw sqlite_error(db_handle, db_err, context);
+            return;
+        }
 
-        db_err = sqlite3_exec(db_handle, std::string{statement}.c_str(), nullptr, nullptr, nullptr);
+        for (int db_err; (db_err = sqlite3_step(stmt)) != SQLITE_DONE;)
+            if (db_err != SQLITE_ROW) throw sqlite_error(db_handle, db_err, context);
+    }
 
-        if (db_err != 0) throw sqlite_error(db_handle, db_err, context);
+    auto Database::cached_statement(std::string_view statement, std::string_view context) -> Cached_statement
+    {
+        {
+            auto lock = std::unique_lock{statement_mutex};
+            if (auto it = statement_index.find(statement); it != statement_index.end() && !it->second->in_use) {
+                statements.splice(statements.begin(), statements, it->second);
+                it->second->in_use = true;
+                ++statement_hits;
+                return { this, it->second->stmt, true };
+            }
+        }
+
+        ++statement_misses;
+        sqlite3_stmt* stmt = nullptr;
+        const char* tail = nullptr;
+        auto err = sqlite3_prepare_v2(db_handle, statement.data(), static_cast<int>(statement.size()), &stmt, &tail);
+        if (err != SQLITE_OK) throw sqlite_error(db_handle, err, context.empty() ? "trying to prepare statement" : context);
+
+        auto rest = std::string_view{ tail, statement.data() + statement.size() };
+        if (!stmt || rest.find_first_not_of(" \t\r\n;") != std::string_view::npos) {
+            sqlite3_finalize(stmt);
+            return {};
+        }
+
+        register_columns(stmt);
+
+        // A statement already in use (by a caller up the stack, or another thread) gets a private copy
+        auto lock = std::unique_lock{statement_mutex};
+        if (statement_index.contains(statement)) return { this, stmt, false };
+        statements.push_front({ std::string{ statement }, stmt, true });
+        statement_index.emplace(statements.front().sql, statements.begin());
+        trim_statement_cache();
+        return { this, stmt, true };
     }
 
-    auto Database::get_row(sqlite3_stmt* stmt) -> Row
+    void Database::give_back(sqlite3_stmt* stmt, bool cached)
     {
-        using namespace std::string_literals;
+        if (!cached) {
+            finalize(stmt);
+            return;
+        }
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
 
-        Row row;
-        for (auto i = 0U; i < sqlite3_column_count(stmt); i++) {
-            if (sqlite3_column_type(stmt, i) == SQLITE_NULL)
-                row.push_back(Value{nullptr});
-            else {
-                auto type = sqlite3_column_decltype(stmt, i);
-                if (type == nullptr || "INTEGER"s == type)
-                    row.push_back(Value{sqlite3_column_int64 (stmt, i)});
-                else if ("FLOAT"s == type) 
-                    row.push_back(Value{sqlite3_column_double(stmt, i)});
-                else if ("BLOB"s == type) {
-                    auto data = (const uint8_t*)sqlite3_column_blob(stmt, i);
-                    auto size = sqlite3_column_bytes(stmt, i);
-                    row.push_back(std::move(Blob{data, data + size}));
-                }
-                else if ("STRING"s == type) {
-                    auto text = (const char*)sqlite3_column_text(stmt, i);
-                    row.push_back(Value{text ? text : ""});
-                }
-                else if ("NULL"s == type)
-                    row.push_back(Value{nullptr});
-                else if ("DATETIME"s == type) {
-                    auto text = (const char*)sqlite3_column_text(stmt, i);
-                    row.push_back(Value{ text ? text : "" });
-                }
-                else
-                    assert(false);
+        auto lock = std::unique_lock{statement_mutex};
+        auto it = std::find_if(statements.begin(), statements.end(), [stmt](auto& entry) { return entry.stmt == stmt; });
+        if (it != statements.end()) it->in_use = false;
+        trim_statement_cache();
+    }
+
+    void Database::trim_statement_cache()
+    {
+        // Statements in use are skipped: the cache can exceed its capacity until they are given back
+        for (auto it = statements.end(); statements.size() > statement_capacity && it != statements.begin();) {
+            --it;
+            if (it->in_use) continue;
+            statement_index.erase(it->sql);
+            statement_columns.erase(it->stmt);
+            sqlite3_finalize(it->stmt);
+            it = statements.erase(it);
+            ++statement_evictions;
+        }
+    }
+
+    // Declared types as SQLite reads them (type affinity), with this schema's STRING and DATETIME as text
+    static auto column_kind(const char* declared_type) -> Column_kind
+    {
+        if (declared_type == nullptr) return Column_kind::dynamic;
+        auto type = std::string{ declared_type };
+        std::transform(type.begin(), type.end(), type.begin(), [](char ch) { return static_cast<char>(toupper(ch)); });
+        if (type.find("INT") != std::string::npos) return Column_kind::integer;
+        if (type.find("CHAR") != std::string::npos || type.find("CLOB") != std::string::npos || type.find("TEXT") != std::string::npos
+            || type.find("STRING") != std::string::npos || type.find("DATE") != std::string::npos) return Column_kind::text;
+        if (type.find("BLOB") != std::string::npos) return Column_kind::blob;
+        if (type.find("REAL") != std::string::npos || type.find("FLOA") != std::string::npos || type.find("DOUB") != std::string::npos) return Column_kind::real;
+        return Column_kind::dynamic;
+    }
+
+    auto Row_view::value(int col) const -> Value
+    {
+        auto kind = (*kinds)[col];
+        auto type = sqlite3_column_type(stmt, col);
+        if (type == SQLITE_NULL) return nullptr;
+        if (kind == Column_kind::dynamic) {
+            switch (type) {
+            case SQLITE_INTEGER: kind = Column_kind::integer; break;
+            case SQLITE_FLOAT  : kind = Column_kind::real; break;
+            case SQLITE_BLOB   : kind = Column_kind::blob; break;
+            default            : kind = Column_kind::text;
             }
         }
+        switch (kind) {
+        case Column_kind::integer: return int64(col);
+        case Column_kind::real   : return real(col);
+        case Column_kind::blob   : { auto data = blob(col); return Blob{ data.begin(), data.end() }; }
+        default                  : return std::string{ text(col) };
+        }
+    }
+
+    auto Row_view::to_row() const -> Row
+    {
+        Row row;
+        row.reserve(kinds->size());
+        for (auto i = 0; i < size(); i++)
+            row.push_back(value(i));
         return row;
     }
 
+    void Database::register_columns(sqlite3_stmt* stmt)
+    {
+        Column_kinds kinds(sqlite3_column_count(stmt));
+        for (auto i = 0U; i < kinds.size(); i++)
+            kinds[i] = column_kind(sqlite3_column_decltype(stmt, static_cast<int>(i)));
+        auto lock = std::unique_lock{statement_mutex};
+        statement_columns.insert_or_assign(stmt, std::move(kinds));
+    }
+
+    auto Database::row_view(sqlite3_stmt* stmt) -> Row_view
+    {
+        {
+            auto lock = std::unique_lock{statement_mutex};
+            if (auto it = statement_columns.find(stmt); it != statement_columns.end())
+                return { stmt, it->second };
+        }
+        // (A statement prepared directly through the SQLite API)
+        register_columns(stmt);
+        auto lock = std::unique_lock{statement_mutex};
+        return { stmt, statement_columns.at(stmt) };
+    }
+
+    auto Database::get_row(sqlite3_stmt* stmt) -> Row
+    {
+        return row_view(stmt).to_row();
+    }
+
+    bool Database::step(sqlite3_stmt* stmt)
+    {
+        auto code = sqlite3_step(stmt);
+        if (code == SQLITE_ROW) return true;
+        if (code == SQLITE_DONE) return false;
+        throw sqlite_error(db_handle, code, "trying to step through prepared statement");
+    }
+
+    void Database::check_result(int code, std::string_view context)
+    {
+        if (code != SQLITE_OK) throw sqlite_error(db_handle, code, context);
+    }
+
+    void Database::check_statement_shape(sqlite3_stmt* stmt, size_t params, size_t columns, std::string_view sql)
+    {
+        auto actual_params = static_cast<size_t>(sqlite3_bind_parameter_count(stmt));
+        auto actual_columns = static_cast<size_t>(sqlite3_column_count(stmt));
+        if (actual_params != params || actual_columns != columns)
+            throw std::logic_error(std::format("statement has {0} parameters and {1} columns, expected {2} and {3}: {4}",
+                actual_params, actual_columns, params, columns, sql));
+    }
+
+    void Database::finalize(sqlite3_stmt* stmt)
+    {
+        {
+            auto lock = std::unique_lock{statement_mutex};
+            statement_columns.erase(stmt);
+        }
+        sqlite3_finalize(stmt);
+    }
+
     void Database::drop_table(std::string_view version)
     {
         exec(std::format("drop table if exists {0};", version).c_str(), std::format("trying to drop table \"{0}\"", version));
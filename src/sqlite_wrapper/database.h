@@ -4,7 +4,11 @@
 #include <string>
 #include <string_view>
 #include <map>
+#include <list>
+#include <unordered_map>
+#include <mutex>
 #include <future>
+#include <span>
 #include <variant>
 #include <sqlite3.h>
 
@@ -41,6 +45,33 @@ namespace SQLite {
 
     using Rows = std::vector<Row>;
 
+    // How the values of a column are decoded, from its declared type (determined once per statement);
+    // expressions have no declared type, their values are decoded by their own type
+    enum class Column_kind: uint8_t { integer, real, text, blob, dynamic };
+
+    using Column_kinds = std::vector<Column_kind>;
+
+    // The current row of a statement, read in place: the strings and blobs point into SQLite's own buffers,
+    // and are only valid until the statement is stepped again or reset
+    class Row_view {
+    public:
+        Row_view(sqlite3_stmt* stmt, const Column_kinds& kinds): stmt{stmt}, kinds{&kinds} {}
+
+        auto size() const -> int { return static_cast<int>(kinds->size()); }
+        bool is_null(int col) const { return sqlite3_column_type(stmt, col) == SQLITE_NULL; }
+        auto int64(int col) const -> int64_t { return sqlite3_column_int64(stmt, col); }
+        auto real(int col) const -> double { return sqlite3_column_double(stmt, col); }
+        auto text(int col) const -> std::string_view;           // empty if NULL
+        auto blob(int col) const -> std::span<const uint8_t>;
+
+        auto value(int col) const -> Value;     // copied, decoded according to the column kind
+        auto to_row() const -> Row;
+
+    private:
+        sqlite3_stmt           *stmt;
+        const Column_kinds     *kinds;
+    };
+
     template <typename Cargo> class Grouping_node;
     template <typename Cargo> class Row_packet_node;
     template <typename Cargo> class Row_content;
@@ -61,7 +92,37 @@ namespace SQLite {
     template <typename Cargo>
     class Row_packet_node: public std::vector<Row_content<Cargo>> {};
 
-    class Statement;
+    class Database;
+
+    // Statement cache counters, over all the connections of the process
+    struct Statement_cache_stats {
+        int64_t     hits = 0;
+        int64_t     misses = 0;     // statements that had to be prepared
+        int64_t     evictions = 0;  // statements finalized to make room for others
+    };
+
+    auto statement_cache_stats() -> Statement_cache_stats;
+
+    // A statement borrowed from the statement cache of a connection (or prepared just for the borrower, if the
+    // cached one is already in use). Giving it back resets it and clears its bindings.
+    class Cached_statement {
+    public:
+        Cached_statement() = default;
+        Cached_statement(Cached_statement&&) noexcept;
+        auto operator = (Cached_statement&&) noexcept -> Cached_statement&;
+        ~Cached_statement();
+
+        operator sqlite3_stmt* () const { return stmt; }
+        explicit operator bool () const { return stmt != nullptr; }
+
+    private:
+        friend class Database;
+        Cached_statement(Database* database, sqlite3_stmt* stmt, bool cached): database{database}, stmt{stmt}, cached{cached} {}
+
+        Database       *database = nullptr;
+        sqlite3_stmt   *stmt = nullptr;
+        bool            cached = false;     // false: finalized when given back
+    };
 
 
     class Database {
@@ -72,7 +133,7 @@ namespace SQLite {
 
         using select_callback = std::function<int(int col_count, const char* const col_names[], const char* const col_values[])>;
 
-        Database(const char *filename);
+        Database(const char *filename, size_t statement_cache_capacity = 64);
         virtual ~Database();
 
         void select(const char* statement, select_callback);
@@ -96,6 +157,11 @@ namespace SQLite {
             std::string order_by = ""
         ) -> Query_result_node<Cargo>;
 
+        // Ad-hoc statements, prepared once per connection and kept by SQL text (the least recently used ones
+        // are finalized beyond the capacity of the cache). Null if the text holds several statements, which
+        // are not cached.
+        auto cached_statement(std::string_view statement, std::string_view context = "") -> Cached_statement;
+
         // Prepare a "select" statement.
         auto prepare_statement(
             std::string_view statement
@@ -114,7 +180,20 @@ namespace SQLite {
 
         void execute(std::string_view statement, std::string_view context = "");
 
-        auto get_row(sqlite3_stmt*) -> Row;
+        auto get_row(sqlite3_stmt*) -> Row;     // copied out; see row_view() for reading rows in place
+
+        // The current row of a statement (after execute() returned true)
+        auto row_view(sqlite3_stmt*) -> Row_view;
+
+        // For the statements obtained from prepare_statement() (forgets their column kinds)
+        void finalize(sqlite3_stmt*);
+
+        // Lower level, for typed statements (see statement.h): steps a statement (true if it produced a
+        // row), throws if an SQLite result code is an error, or if a statement does not have the expected
+        // numbers of parameters and columns (the statement is left to the caller to finalize)
+        bool step(sqlite3_stmt*);
+        void check_result(int code, std::string_view context);
+        void check_statement_shape(sqlite3_stmt*, size_t params, size_t columns, std::string_view sql);
 
     protected:
         
@@ -122,6 +201,19 @@ namespace SQLite {
 
     private:
 
+        friend class Cached_statement;
+
+        struct Cache_entry {
+            std::string     sql;
+            sqlite3_stmt   *stmt = nullptr;
+            bool            in_use = false;
+        };
+
+        void give_back(sqlite3_stmt*, bool cached);
+        void register_columns(sqlite3_stmt*);
+
+        void trim_statement_cache();    // (with statement_mutex locked)
+
         static auto escape_single_quotes(std::string_view s) -> std::string;
 
         auto query_single_row(const char *list_query, const char *context = nullptr) -> std::vector<std::string>;
@@ -137,6 +229,12 @@ namespace SQLite {
 
         sqlite3         *db_handle = nullptr;
         sqlite3_stmt    *stmt_upsert_package_description = nullptr;
+
+        std::mutex      statement_mutex;
+        size_t          statement_capacity;
+        std::list<Cache_entry> statements;     // most recently used first
+        std::unordered_map<std::string_view, std::list<Cache_entry>::iterator> statement_index;    // by sql
+        std::unordered_map<sqlite3_stmt*, Column_kinds> statement_columns;     // of all live statements
     };
 
 } // ns SQLite
@@ -150,6 +248,19 @@ namespace SQLite {
 
 namespace SQLite {
 
+    inline auto Row_view::text(int col) const -> std::string_view
+    {
+        // (sqlite3_column_bytes() must come after sqlite3_column_text(), which may convert the value)
+        auto text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, col));
+        return text ? std::string_view{ text, static_cast<size_t>(sqlite3_column_bytes(stmt, col)) } : std::string_view{};
+    }
+
+    inline auto Row_view::blob(int col) const -> std::span<const uint8_t>
+    {
+        auto data = static_cast<const uint8_t*>(sqlite3_column_blob(stmt, col));
+        return { data, data ? static_cast<size_t>(sqlite3_column_bytes(stmt, col)) : 0U };
+    }
+
     template<typename Cargo>
     inline auto Database::get_tree(
         std::string_view table,
@@ -0,0 +1,235 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <sqlite3.h>
+#include "./database.h"
+
+
+namespace SQLite {
+
+    // Parameter and column types of typed statements
+    namespace detail {
+
+        template <typename T> struct is_optional: std::false_type {};
+        template <typename T> struct is_optional<std::optional<T>>: std::true_type {};
+
+        // Returns an SQLite result code. Strings and blobs are copied by SQLite (SQLITE_TRANSIENT), so that
+        // the arguments need not outlive the call.
+        template <typename T>
+        inline auto bind(sqlite3_stmt* stmt, int index, const T& value) -> int
+        {
+            if constexpr (is_optional<T>::value)
+                return value ? bind(stmt, index, *value) : sqlite3_bind_null(stmt, index);
+            else if constexpr (std::is_same_v<T, std::nullptr_t>)
+                return sqlite3_bind_null(stmt, index);
+            else if constexpr (std::is_same_v<T, bool> || std::is_integral_v<T>)
+                return sqlite3_bind_int64(stmt, index, static_cast<int64_t>(value));
+            else if constexpr (std::is_floating_point_v<T>)
+                return sqlite3_bind_double(stmt, index, static_cast<double>(value));
+            else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+                auto text = std::string_view{ value };
+                return sqlite3_bind_text(stmt, index, text.data(), static_cast<int>(text.size()), SQLITE_TRANSIENT);
+            }
+            else if constexpr (std::is_convertible_v<const T&, std::span<const uint8_t>>) {
+                auto data = std::span<const uint8_t>{ value };
+                return sqlite3_bind_blob(stmt, index, data.data(), static_cast<int>(data.size()), SQLITE_TRANSIENT);
+            }
+            else
+                static_assert(!sizeof(T), "unsupported parameter type");
+        }
+
+        // std::string_view and std::span columns point into SQLite's buffers: they are only valid until the
+        // statement is stepped again or reset. NULL is decoded as 0 or empty, unless the type is an optional.
+        template <typename T>
+        inline auto column(sqlite3_stmt* stmt, int col) -> T
+        {
+            if constexpr (is_optional<T>::value) {
+                if (sqlite3_column_type(stmt, col) == SQLITE_NULL) return std::nullopt;
+                return column<typename T::value_type>(stmt, col);
+            }
+            else if constexpr (std::is_same_v<T, bool>)
+                return sqlite3_column_int64(stmt, col) != 0;
+            else if constexpr (std::is_integral_v<T>)
+                return static_cast<T>(sqlite3_column_int64(stmt, col));
+            else if constexpr (std::is_floating_point_v<T>)
+                return static_cast<T>(sqlite3_column_double(stmt, col));
+            else if constexpr (std::is_same_v<T, std::string_view> || std::is_same_v<T, std::string>) {
+                auto text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, col));
+                return text ? T{ text, static_cast<size_t>(sqlite3_column_bytes(stmt, col)) } : T{};
+            }
+            else if constexpr (std::is_same_v<T, std::span<const uint8_t>> || std::is_same_v<T, Blob>) {
+                auto data = static_cast<const uint8_t*>(sqlite3_column_blob(stmt, col));
+                auto size = data ? static_cast<size_t>(sqlite3_column_bytes(stmt, col)) : 0U;
+                return T{ data, data + size };
+            }
+            else
+                static_assert(!sizeof(T), "unsupported column type");
+        }
+
+    } // ns detail
+
+
+    /**
+     * A statement that is prepared the first time it is used, rather than when it is declared: a class can declare
+     * all the statements it may need (e.g. Cache_db), while each connection only prepares those it actually runs.
+     * The numbers of parameters and columns, if given, are checked when the statement gets prepared.
+     */
+    class Deferred_statement {
+    public:
+        struct Shape {
+            size_t params;
+            size_t columns;
+        };
+
+        Deferred_statement() = default;
+
+        Deferred_statement(Database& db, std::string_view sql, std::optional<Shape> shape = {}):
+            database{&db}, sql{sql}, shape{shape}
+        {}
+
+        Deferred_statement(Deferred_statement&& other) noexcept:
+            database{other.database}, sql{std::move(other.sql)}, shape{other.shape}, stmt{std::exchange(other.stmt, nullptr)}
+        {}
+
+        auto operator = (Deferred_statement&& other) noexcept -> Deferred_statement&
+        {
+            if (this != &other) {
+                if (stmt) database->finalize(stmt);
+                database = other.database;
+                sql = std::move(other.sql);
+                shape = other.shape;
+                stmt = std::exchange(other.stmt, nullptr);
+            }
+            return *this;
+        }
+
+        ~Deferred_statement() { if (stmt) database->finalize(stmt); }
+
+        auto prepare() -> sqlite3_stmt*
+        {
+            if (!stmt) {
+                auto prepared = database->prepare_statement(sql);
+                if (shape) {
+                    try {
+                        database->check_statement_shape(prepared, shape->params, shape->columns, sql);
+                    }
+                    catch (...) {
+                        database->finalize(prepared);
+                        throw;
+                    }
+                }
+                stmt = prepared;
+            }
+            return stmt;
+        }
+
+        auto prepared() const -> sqlite3_stmt* { return stmt; }    // null if it has not been used yet
+
+        operator sqlite3_stmt* () { return prepare(); }
+
+    private:
+        Database           *database = nullptr;
+        std::string         sql;
+        std::optional<Shape> shape;
+        sqlite3_stmt       *stmt = nullptr;
+    };
+
+
+    template <typename Signature> class Statement;
+
+    /**
+     * A prepared statement with typed parameters and columns, declared as a function type:
+     * Statement<std::tuple<Columns...>(Params...)>, e.g.
+     *
+     *     Statement<std::tuple<int64_t, std::string_view>(std::string_view)> find{ db, "SELECT id, name FROM t WHERE name LIKE ?1" };
+     *
+     * (std::tuple<> for statements that return nothing). The statement is only prepared when it is first bound
+     * (see Deferred_statement), and the numbers of parameters and columns are then checked against the SQL; the
+     * values are bound and decoded without going through SQLite::Value. Rows can also be decoded into structs
+     * whose members are the columns, in order.
+     */
+    template <typename... Columns, typename... Params>
+    class Statement<std::tuple<Columns...>(Params...)> {
+    public:
+        using Row = std::tuple<Columns...>;
+
+        Statement() = default;
+
+        Statement(Database& db, std::string_view sql):
+            database{&db}, statement{db, sql, Deferred_statement::Shape{ sizeof...(Params), sizeof...(Columns) }}
+        {}
+
+        // (Re)starts the statement with the given parameters
+        auto bind(const Params&... params) -> Statement&
+        {
+            auto stmt = statement.prepare();
+            sqlite3_reset(stmt);
+            auto index = 0;
+            (database->check_result(detail::bind(stmt, ++index, params), "trying to bind a statement parameter"), ...);
+            return *this;
+        }
+
+        // Steps to the next row; false once there is none left
+        bool step() { return database->step(statement.prepared()); }
+
+        auto row() const -> Row { return row(std::index_sequence_for<Columns...>{}); }
+
+        template <typename Struct>
+        auto row_as() const -> Struct { return std::make_from_tuple<Struct>(row()); }
+
+        // Runs the statement to completion (e.g. for an INSERT)
+        void execute(const Params&... params)
+        {
+            bind(params...);
+            while (step()) {}
+            sqlite3_reset(statement.prepared());
+        }
+
+        // First row, if any (the statement is reset afterwards, so the row must not contain views)
+        auto first(const Params&... params) -> std::optional<Row>
+        {
+            bind(params...);
+            std::optional<Row> result;
+            if (step()) result = row();
+            sqlite3_reset(statement.prepared());
+            return result;
+        }
+
+        // Calls fn(row) for every row, as long as it returns true (if it returns a bool)
+        template <typename Fn>
+        void for_each(Fn fn, const Params&... params)
+        {
+            bind(params...);
+            while (step()) {
+                if constexpr (std::is_same_v<decltype(fn(row())), bool>) {
+                    if (!fn(row())) break;
+                }
+                else
+                    fn(row());
+            }
+            sqlite3_reset(statement.prepared());
+        }
+
+        operator sqlite3_stmt* () { return statement.prepare(); }
+
+    private:
+
+        template <size_t... I>
+        auto row(std::index_sequence<I...>) const -> Row
+        {
+            return Row{ detail::column<Columns>(statement.prepared(), static_cast<int>(I))... };
+        }
+
+        Database           *database = nullptr;
+        Deferred_statement  statement;
+    };
+
+} // ns SQLite
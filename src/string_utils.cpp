@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <regex>
 #include <stdexcept>
 #include <format>
 #include "./string_utils.h"
@@ -65,3 +67,16 @@ auto parseTagList(std::string_view text) -> std::vector<std::string>
 
     return list;
 }
+
+auto semver_key(std::string_view version) -> std::optional<int64_t>
+{
+    static const auto re = std::regex("^(\\d+)\\.(\\d+)(?:\\.(\\d+)(?:[\\.\\-](\\d+))?)?$");
+
+    std::cmatch m;
+    if (!std::regex_match(version.data(), version.data() + version.size(), m, re)) return {};
+
+    int64_t key = 0;
+    for (auto i = 1; i <= 4; i++)
+        key = (key << 16) | (m[i].matched ? std::min(std::stoll(m[i]), 0xffffLL) : 0);
+    return key;
+}
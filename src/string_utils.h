@@ -5,6 +5,8 @@
 #include <numeric>
 #include <string>
 #include <vector>
+#include <optional>
+#include <cstdint>
 
 
 template <typename Seq> // requires sequence_of_convertibles_to_string<Seq>
@@ -15,5 +17,25 @@ auto join_strings(Seq strings, std::string_view separator = ",") -> std::string
 }
 
 
+// Calls fn(std::string_view) for every line of text (without line terminator, CR/LF or LF)
+template <typename Fn>
+void for_each_line(std::string_view text, Fn fn)
+{
+    while (!text.empty()) {
+        auto eol = text.find('\n');
+        auto line = text.substr(0, eol);
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        fn(line);
+        if (eol == std::string_view::npos) break;
+        text.remove_prefix(eol + 1);
+    }
+}
+
+
+// Sortable key for a semantic version ("1.2", "1.2.3", "1.2.3.4" or "1.2.3-4"): the 4 parts, 16 bits each.
+// Empty if the version does not have that form (e.g. "cci.20211015").
+auto semver_key(std::string_view version) -> std::optional<int64_t>;
+
+
 // TODO: better name ?
 auto parseTagList(std::string_view text) -> std::vector<std::string>;
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstdint>
+#include <map>
 #include <vector>
 #include <string>
 
@@ -23,5 +25,15 @@ struct Package_info {
     std::string author;
     std::vector<std::string> topics;
     std::string creation_date;
+    std::map<std::string, std::string> attributes;  // the other attributes "conan inspect" printed (url, homepage, settings, options...)
 };
 
+struct Remote_entry {
+    std::string name;
+    std::string url;
+    bool        verify_ssl = true;
+    bool        enabled = true;
+    int64_t     priority = 0;           // position in conan's list (0 = searched first)
+    std::string last_health_check;      // empty if never checked
+    bool        healthy = true;
+};
@@ -0,0 +1,214 @@
+/**
+ * Stand-in for the "conan" executable, serving a synthetic catalogue (see synthetic_catalogue.h).
+ *
+ * Usage:
+ *   fake_conan generate [--names N] [--seed S] [--remotes a,b,...] [--alpha A] [--max-versions M]
+ *                       [--users U] [--channels C] [-o FILE]
+ *   fake_conan remote list
+ *   fake_conan search -r REMOTE PATTERN [--raw] [--case-sensitive]
+ *   fake_conan inspect -r REMOTE REFERENCE
+ *
+ * The catalogue served is read from the file named by FAKE_CONAN_CATALOGUE. Behaviour can be tuned with:
+ *   FAKE_CONAN_LATENCY_MS       fixed delay before any output (simulates process start + round trip)
+ *   FAKE_CONAN_LINE_LATENCY_US  additional delay per output line of "search"
+ *   FAKE_CONAN_ERROR_RATE       probability (0..1) that a command fails with a random server error
+ *   FAKE_CONAN_HANG_RATE        probability (0..1) that a command hangs (never completes)
+ *   FAKE_CONAN_SEED             makes latency/error injection reproducible
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <format>
+#include "./synthetic_catalogue.h"
+
+
+using namespace Synthetic;
+
+
+static auto env_double(const char* name, double default_value = 0) -> double
+{
+    auto value = std::getenv(name);
+    return value ? std::atof(value) : default_value;
+}
+
+static auto load_catalogue() -> Catalogue
+{
+    auto path = std::getenv("FAKE_CONAN_CATALOGUE");
+    if (!path) throw std::runtime_error("FAKE_CONAN_CATALOGUE is not set");
+    std::ifstream is{ path };
+    if (!is) throw std::runtime_error(std::format("Unable to open catalogue file \"{0}\"", path));
+    return Catalogue::read(is);
+}
+
+static auto option_value(const std::vector<std::string>& args, std::string_view option) -> std::string
+{
+    for (auto i = 0U; i + 1 < args.size(); i++)
+        if (args[i] == option) return args[i + 1];
+    return {};
+}
+
+static bool has_flag(const std::vector<std::string>& args, std::string_view flag)
+{
+    return std::find(args.begin(), args.end(), flag) != args.end();
+}
+
+// First argument that is neither an option nor an option's value
+static auto positional(const std::vector<std::string>& args, size_t skip = 0) -> std::string
+{
+    for (auto i = skip; i < args.size(); i++) {
+        if (args[i] == "-r" || args[i] == "--remote") { i++; continue; }
+        if (args[i].starts_with("-")) continue;
+        return args[i];
+    }
+    return {};
+}
+
+static int generate(const std::vector<std::string>& args)
+{
+    Generator_params params;
+    if (auto v = option_value(args, "--names"       ); !v.empty()) params.name_count    = std::stoull(v);
+    if (auto v = option_value(args, "--seed"        ); !v.empty()) params.seed          = std::stoull(v);
+    if (auto v = option_value(args, "--alpha"       ); !v.empty()) params.version_alpha = std::stod(v);
+    if (auto v = option_value(args, "--max-versions"); !v.empty()) params.max_versions  = std::stoull(v);
+    if (auto v = option_value(args, "--users"       ); !v.empty()) params.user_pool     = std::stoull(v);
+    if (auto v = option_value(args, "--channels"    ); !v.empty()) params.channel_pool  = std::stoull(v);
+    if (auto v = option_value(args, "--remotes"     ); !v.empty()) {
+        params.remotes.clear();
+        for (size_t pos = 0; pos != std::string::npos;) {
+            auto comma = v.find(',', pos);
+            params.remotes.push_back(v.substr(pos, comma - pos));
+            pos = comma == std::string::npos ? comma : comma + 1;
+        }
+    }
+
+    auto catalogue = Catalogue::generate(params);
+
+    if (auto output = option_value(args, "-o"); !output.empty()) {
+        std::ofstream os{ output };
+        catalogue.write(os);
+    }
+    else
+        catalogue.write(std::cout);
+
+    std::cerr << std::format("Generated {0} references over {1} names on {2} remote(s)",
+        catalogue.references.size(), params.name_count, catalogue.remotes.size()) << std::endl;
+    return 0;
+}
+
+static int remote_list(const Catalogue& catalogue)
+{
+    for (auto& remote : catalogue.remotes)
+        std::cout << std::format("{0}: {1} [Verify SSL: True]", remote.name, remote.url) << '\n';
+    return 0;
+}
+
+static int search(const Catalogue& catalogue, const std::vector<std::string>& args)
+{
+    auto remote = option_value(args, "-r");
+    auto pattern = positional(args, 1);
+    auto case_sensitive = has_flag(args, "--case-sensitive");
+    auto line_latency = std::chrono::microseconds{ static_cast<int64_t>(env_double("FAKE_CONAN_LINE_LATENCY_US")) };
+
+    if (remote.empty()) return 0; // local cache is always empty
+
+    if (remote != "all" && std::none_of(catalogue.remotes.begin(), catalogue.remotes.end(), [&](auto& r) { return r.name == remote; })) {
+        std::cerr << std::format("ERROR: No remote '{0}' defined in remotes", remote) << std::endl;
+        return 1;
+    }
+
+    for (auto& ref : catalogue.references) {
+        if (remote != "all" && ref.remote != remote) continue;
+        if (!glob_match(pattern, ref.name, case_sensitive)) continue;
+        if (line_latency.count() > 0) std::this_thread::sleep_for(line_latency);
+        if (ref.user.empty())
+            std::cout << ref.name << '/' << ref.version << '\n';
+        else
+            std::cout << ref.to_string() << '\n';
+    }
+    return 0;
+}
+
+static int inspect(const Catalogue& catalogue, const std::vector<std::string>& args)
+{
+    auto remote = option_value(args, "-r");
+    auto spec = positional(args, 1);
+
+    for (auto& ref : catalogue.references) {
+        if (!remote.empty() && ref.remote != remote) continue;
+        if (ref.to_string() == spec || (ref.user.empty() && spec == ref.name + "/" + ref.version)) {
+            std::cout << inspect_output(ref);
+            return 0;
+        }
+    }
+
+    std::cerr << std::format("ERROR: Unable to find '{0}' in remotes", spec) << std::endl;
+    return 1;
+}
+
+// Simulated latency, failures and hangs
+static auto inject_faults(const std::vector<std::string>& args) -> int
+{
+    std::mt19937_64 rng;
+    if (auto seed = std::getenv("FAKE_CONAN_SEED")) {
+        rng.seed(std::stoull(seed) ^ std::hash<std::string>{}(args.back()));
+    }
+    else
+        rng.seed(std::random_device{}());
+    std::uniform_real_distribution<double> uniform{ 0.0, 1.0 };
+
+    auto latency = env_double("FAKE_CONAN_LATENCY_MS");
+    if (latency > 0) std::this_thread::sleep_for(std::chrono::milliseconds{ static_cast<int64_t>(latency) });
+
+    if (uniform(rng) < env_double("FAKE_CONAN_HANG_RATE"))
+        std::this_thread::sleep_for(std::chrono::hours{ 24 });
+
+    if (uniform(rng) < env_double("FAKE_CONAN_ERROR_RATE")) {
+        static const char* errors[] = {
+            "ERROR: 503: Service Unavailable",
+            "ERROR: 502: Bad Gateway",
+            "ERROR: HTTPSConnectionPool(host='remote.example.invalid', port=443): Read timed out. (read timeout=60.0)",
+            "ERROR: 429: Too Many Requests",
+            "ERROR: 401: Unauthorized",
+        };
+        std::cerr << errors[rng() % std::size(errors)] << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    std::vector<std::string> args{ argv + 1, argv + argc };
+
+    try {
+        if (args.empty()) {
+            std::cerr << "Usage: fake_conan (generate|remote list|search|inspect) ..." << std::endl;
+            return 2;
+        }
+
+        if (args[0] == "generate") return generate(args);
+
+        if (auto err = inject_faults(args); err != 0) return err;
+
+        auto catalogue = load_catalogue();
+
+        if (args[0] == "remote" && args.size() > 1 && args[1] == "list") return remote_list(catalogue);
+        if (args[0] == "search" ) return search(catalogue, args);
+        if (args[0] == "inspect") return inspect(catalogue, args);
+
+        std::cerr << std::format("ERROR: Unknown command '{0}'", args[0]) << std::endl;
+        return 2;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "ERROR: " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,287 @@
+/**
+ * Mock Conan server: the subset of the REST API (v2) that conan-gui uses, serving a synthetic catalogue
+ * (see synthetic_catalogue.h) over plain HTTP/1.1 with keep-alive and pipelining. Every remote of the
+ * catalogue is served under its own path, so pointing the remote URLs of the catalogue at the server,
+ * e.g.
+ *   remote <TAB> conancenter <TAB> http://127.0.0.1:9300/conancenter
+ * makes fake_conan's "remote list" (and thus conan-gui's REST client) use it.
+ *
+ * Usage:
+ *   mock_conan_server [--port P]
+ *
+ * Endpoints (relative to a remote URL; "_" stands for an empty user or channel):
+ *   GET /v1/ping
+ *   GET /v2/conans/search?q=PATTERN[&ignorecase=False]
+ *   GET /v2/conans/NAME/VERSION/USER/CHANNEL/latest
+ *   GET /v2/conans/NAME/VERSION/USER/CHANNEL/revisions
+ *   GET /v2/conans/NAME/VERSION/USER/CHANNEL/revisions/REVISION/files/conanfile.py
+ *
+ * The catalogue is read from the file named by FAKE_CONAN_CATALOGUE; FAKE_CONAN_LATENCY_MS delays every
+ * response. The number of requests served is printed when a connection closes.
+ *
+ * POSIX only.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+#include <format>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "./synthetic_catalogue.h"
+
+
+using namespace Synthetic;
+
+
+namespace {
+
+    struct Http_response {
+        int         status = 200;
+        std::string content_type = "application/json";
+        std::string body;
+    };
+
+    struct Served_remote {
+        std::vector<const Reference*>               references;
+        std::map<std::string, const Reference*>     by_path;    // "name/version/user/channel"
+    };
+
+    std::map<std::string, Served_remote>    remotes;
+    std::chrono::milliseconds               latency{};
+    std::atomic<unsigned>                   connection_count = 0;
+
+    auto status_text(int status) -> std::string_view
+    {
+        switch (status) {
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        default : return "Internal Server Error";
+        }
+    }
+
+    auto json_string(std::string_view text) -> std::string
+    {
+        std::string out{ '"' };
+        for (auto ch : text) {
+            if (ch == '"' || ch == '\\') out += '\\';
+            out += ch;
+        }
+        return out + '"';
+    }
+
+    auto url_decode(std::string_view text) -> std::string
+    {
+        std::string out;
+        for (auto i = 0U; i < text.size(); i++) {
+            if (text[i] == '%' && i + 2 < text.size()) {
+                out += static_cast<char>(std::stoi(std::string{ text.substr(i + 1, 2) }, nullptr, 16));
+                i += 2;
+            }
+            else
+                out += text[i] == '+' ? ' ' : text[i];
+        }
+        return out;
+    }
+
+    auto query_param(std::string_view query, std::string_view name) -> std::optional<std::string>
+    {
+        while (!query.empty()) {
+            auto amp = query.find('&');
+            auto param = query.substr(0, amp);
+            auto eq = param.find('=');
+            if (param.substr(0, eq) == name)
+                return url_decode(eq == std::string_view::npos ? "" : param.substr(eq + 1));
+            if (amp == std::string_view::npos) break;
+            query.remove_prefix(amp + 1);
+        }
+        return {};
+    }
+
+    auto reference_path(const Reference& ref) -> std::string
+    {
+        return std::format("{0}/{1}/{2}/{3}", ref.name, ref.version,
+            ref.user.empty() ? "_" : ref.user, ref.channel.empty() ? "_" : ref.channel);
+    }
+
+    auto not_found(std::string_view what) -> Http_response
+    {
+        return { 404, "application/json", std::format("{{\"errors\": [{{\"status\": 404, \"message\": {0}}}]}}", json_string(what)) };
+    }
+
+    auto search(const Served_remote& remote, std::string_view query) -> Http_response
+    {
+        auto pattern = query_param(query, "q").value_or("*");
+        auto case_sensitive = query_param(query, "ignorecase").value_or("True") == "False";
+
+        std::string body = "{\"results\": [";
+        auto first = true;
+        for (auto ref : remote.references) {
+            if (!glob_match(pattern, ref->name, case_sensitive)) continue;
+            if (!first) body += ", ";
+            body += json_string(ref->user.empty() ? std::format("{0}/{1}", ref->name, ref->version) : ref->to_string());
+            first = false;
+        }
+        return { 200, "application/json", body + "]}" };
+    }
+
+    // Path relative to the remote, without the query string
+    auto route(const Served_remote& remote, std::string_view path, std::string_view query) -> Http_response
+    {
+        if (path == "/v1/ping") return { 200, "text/plain", "" };
+        if (path == "/v2/conans/search") return search(remote, query);
+
+        constexpr std::string_view conans = "/v2/conans/";
+        if (!path.starts_with(conans)) return not_found(path);
+        path.remove_prefix(conans.size());
+
+        // name/version/user/channel, then the resource
+        auto end = size_t{ 0 };
+        for (auto i = 0; i < 4 && end != std::string_view::npos; i++)
+            end = path.find('/', end + (i > 0 ? 1 : 0));
+        if (end == std::string_view::npos) return not_found(path);
+        auto it = remote.by_path.find(std::string{ path.substr(0, end) });
+        if (it == remote.by_path.end()) return not_found(std::format("Recipe not found: '{0}'", path.substr(0, end)));
+        auto& ref = *it->second;
+        auto resource = path.substr(end);
+        auto revision = recipe_revision(ref);
+        auto time = std::string{ "\"2021-06-01T12:00:00.000+0000\"" };
+
+        if (resource == "/latest")
+            return { 200, "application/json", std::format("{{\"revision\": \"{0}\", \"time\": {1}}}", revision, time) };
+        if (resource == "/revisions")
+            return { 200, "application/json", std::format("{{\"reference\": {0}, \"revisions\": [{{\"revision\": \"{1}\", \"time\": {2}}}]}}",
+                json_string(ref.to_string()), revision, time) };
+        if (resource == std::format("/revisions/{0}/files/conanfile.py", revision))
+            return { 200, "text/x-python", conanfile_source(ref) };
+
+        return not_found(path);
+    }
+
+    auto handle(std::string_view method, std::string_view target) -> Http_response
+    {
+        if (method != "GET") return { 405, "text/plain", "" };
+
+        auto question = target.find('?');
+        auto path = target.substr(0, question);
+        auto query = question == std::string_view::npos ? std::string_view{} : target.substr(question + 1);
+
+        // First segment: remote
+        if (path.size() < 2 || path[0] != '/') return { 400, "text/plain", "" };
+        auto slash = path.find('/', 1);
+        auto it = remotes.find(std::string{ path.substr(1, slash - 1) });
+        if (it == remotes.end() || slash == std::string_view::npos) return not_found(path);
+        return route(it->second, path.substr(slash), query);
+    }
+
+    void serve_connection(int fd)
+    {
+        auto id = ++connection_count;
+        auto requests = 0U;
+        std::string buffer;
+        char chunk[16384];
+
+        for (auto keep_alive = true; keep_alive;) {
+            auto header_end = buffer.find("\r\n\r\n");
+            if (header_end == std::string::npos) {
+                auto count = recv(fd, chunk, sizeof(chunk), 0);
+                if (count <= 0) break;
+                buffer.append(chunk, count);
+                continue;
+            }
+
+            // Requests are handled in order, so pipelined ones are answered in order too
+            auto head = std::string_view{ buffer }.substr(0, header_end);
+            auto line_end = head.find("\r\n");
+            auto request_line = head.substr(0, line_end);
+            auto sp1 = request_line.find(' '), sp2 = request_line.rfind(' ');
+            auto method = request_line.substr(0, sp1);
+            auto target = request_line.substr(sp1 + 1, sp2 - sp1 - 1);
+            auto http_10 = request_line.substr(sp2 + 1) == "HTTP/1.0";
+
+            std::string lower_head{ head };
+            std::transform(lower_head.begin(), lower_head.end(), lower_head.begin(), [](unsigned char ch) { return static_cast<char>(std::tolower(ch)); });
+            keep_alive = !http_10 && lower_head.find("\r\nconnection: close") == std::string::npos;
+
+            if (latency.count() > 0) std::this_thread::sleep_for(latency);
+            auto response = handle(method, target);
+            ++requests;
+
+            auto out = std::format("HTTP/1.1 {0} {1}\r\nContent-Type: {2}\r\nContent-Length: {3}\r\nX-Conan-Server-Capabilities: revisions\r\n{4}\r\n",
+                response.status, status_text(response.status), response.content_type, response.body.size(),
+                keep_alive ? "" : "Connection: close\r\n");
+            out += response.body;
+            for (size_t sent = 0; sent < out.size();) {
+                auto count = send(fd, out.data() + sent, out.size() - sent, MSG_NOSIGNAL);
+                if (count <= 0) { keep_alive = false; break; }
+                sent += count;
+            }
+
+            buffer.erase(0, header_end + 4);
+        }
+
+        close(fd);
+        std::cerr << std::format("connection {0} closed after {1} request(s)", id, requests) << std::endl;
+    }
+
+} // anonymous ns
+
+int main(int argc, char* argv[])
+{
+    try {
+        auto port = 9300;
+        for (auto i = 1; i + 1 < argc; i++)
+            if (std::strcmp(argv[i], "--port") == 0) port = std::atoi(argv[i + 1]);
+
+        auto path = std::getenv("FAKE_CONAN_CATALOGUE");
+        if (!path) throw std::runtime_error("FAKE_CONAN_CATALOGUE is not set");
+        std::ifstream is{ path };
+        if (!is) throw std::runtime_error(std::format("Unable to open catalogue file \"{0}\"", path));
+        static auto catalogue = Catalogue::read(is);
+
+        for (auto& ref : catalogue.references) {
+            auto& remote = remotes[ref.remote];
+            remote.references.push_back(&ref);
+            remote.by_path[reference_path(ref)] = &ref;
+        }
+        if (auto ms = std::getenv("FAKE_CONAN_LATENCY_MS")) latency = std::chrono::milliseconds{ std::atoi(ms) };
+
+        auto server = socket(AF_INET, SOCK_STREAM, 0);
+        if (server < 0) throw std::runtime_error("Unable to create socket");
+        auto yes = 1;
+        setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(static_cast<uint16_t>(port));
+        if (bind(server, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(server, 64) != 0)
+            throw std::runtime_error(std::format("Unable to listen on port {0}", port));
+
+        std::cerr << std::format("Serving {0} references from {1} remote(s) on http://127.0.0.1:{2}/<remote>",
+            catalogue.references.size(), remotes.size(), port) << std::endl;
+
+        for (;;) {
+            auto fd = accept(server, nullptr, nullptr);
+            if (fd < 0) continue;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+            std::thread{ serve_connection, fd }.detach();
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "ERROR: " << e.what() << std::endl;
+        return 1;
+    }
+}
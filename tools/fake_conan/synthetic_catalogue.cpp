@@ -0,0 +1,309 @@
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <unordered_set>
+#include <format>
+#include "./synthetic_catalogue.h"
+
+
+namespace Synthetic {
+
+    namespace {
+
+        // First letters are deliberately skewed, so that some letters are much "heavier" than others
+        // (like "b", "l" and "o" on real remotes).
+        constexpr std::string_view first_letters = "abcdefghijklmnopqrstuvwxyz";
+        constexpr std::array<double, 26> first_letter_weights = {
+            5, 9, 6, 4, 3, 4, 5, 2, 3, 2, 2, 9, 5, 3, 8, 5, 2, 3, 6, 3, 2, 2, 2, 1, 1, 2
+        };
+
+        constexpr std::array<std::string_view, 32> syllables = {
+            "ab", "ar", "bo", "ce", "da", "el", "fi", "gl", "ho", "in", "ja", "ke", "lo", "mi", "nu", "ox",
+            "pa", "qu", "re", "si", "ta", "ul", "vi", "wa", "xe", "yo", "ze", "ost", "ing", "lib", "ium", "ex"
+        };
+
+        constexpr std::array<std::string_view, 8> name_suffixes = {
+            "", "", "", "", "-cpp", "_utils", "pp", "-core"
+        };
+
+        constexpr std::array<std::string_view, 10> well_known_users = {
+            "bincrafters", "conan", "acme", "platform", "tools", "graphics", "infra", "devkit", "thirdparty", "qa"
+        };
+
+        constexpr std::array<std::string_view, 6> well_known_channels = {
+            "stable", "testing", "dev", "release", "ci", "nightly"
+        };
+
+        constexpr std::array<std::string_view, 24> words = {
+            "fast", "portable", "header-only", "library", "for", "parsing", "compression", "of", "streams",
+            "with", "support", "modern", "C++", "bindings", "and", "a", "small", "footprint", "networking",
+            "cross-platform", "toolkit", "providing", "efficient", "algorithms"
+        };
+
+        constexpr std::array<std::string_view, 20> topic_pool = {
+            "conan", "compression", "networking", "graphics", "math", "serialization", "json", "xml",
+            "logging", "testing", "crypto", "audio", "image", "database", "gui", "parser", "header-only",
+            "embedded", "async", "utility"
+        };
+
+        constexpr std::array<std::string_view, 6> licenses = {
+            "MIT", "BSL-1.0", "Apache-2.0", "BSD-3-Clause", "Zlib", "LGPL-2.1-or-later"
+        };
+
+        auto fnv1a(std::string_view s) -> uint64_t
+        {
+            uint64_t hash = 14695981039346656037ull;
+            for (unsigned char ch : s) { hash ^= ch; hash *= 1099511628211ull; }
+            return hash;
+        }
+
+        auto make_name(std::mt19937_64& rng) -> std::string
+        {
+            static std::discrete_distribution<size_t> letter_dist(first_letter_weights.begin(), first_letter_weights.end());
+
+            std::string name{ first_letters[letter_dist(rng)] };
+            auto syllable_count = 1 + rng() % 3;
+            for (auto i = 0U; i < syllable_count; i++)
+                name += syllables[rng() % syllables.size()];
+            name += name_suffixes[rng() % name_suffixes.size()];
+            return name;
+        }
+
+        auto make_version(std::mt19937_64& rng, size_t index, bool date_based) -> std::string
+        {
+            if (date_based)
+                return std::format("cci.{0}", 20150101 + index * 37);
+            auto major = 1 + index / 20, minor = (index / 4) % 5, patch = index % 4;
+            if (rng() % 4 == 0)
+                return std::format("{0}.{1}.{2}.{3}", major, minor, patch, rng() % 10);
+            return std::format("{0}.{1}.{2}", major, minor, patch);
+        }
+
+        // Power-law distributed number of versions: most names have a handful, a few have hundreds.
+        auto versions_per_name(std::mt19937_64& rng, const Generator_params& params) -> size_t
+        {
+            std::uniform_real_distribution<double> uniform{ 0.0, 1.0 };
+            auto u = uniform(rng);
+            auto n = std::pow(1.0 - u, -1.0 / (params.version_alpha - 1.0));
+            return std::clamp<size_t>(static_cast<size_t>(n), 1, params.max_versions);
+        }
+
+    } // anonymous ns
+
+    auto Reference::to_string() const -> std::string
+    {
+        if (user.empty()) return std::format("{0}/{1}@", name, version);
+        return std::format("{0}/{1}@{2}/{3}", name, version, user, channel);
+    }
+
+    auto Catalogue::generate(const Generator_params& params) -> Catalogue
+    {
+        std::mt19937_64 rng{ params.seed };
+        std::uniform_real_distribution<double> uniform{ 0.0, 1.0 };
+
+        Catalogue catalogue;
+        for (auto& remote : params.remotes)
+            catalogue.remotes.push_back({ remote, std::format("https://{0}.example.invalid/artifactory/api/conan/{0}", remote) });
+
+        std::vector<std::string> users, channels;
+        for (auto i = 0U; i < params.user_pool; i++)
+            users.push_back(i < well_known_users.size() ? std::string{ well_known_users[i] } : std::format("team{0}", i));
+        for (auto i = 0U; i < params.channel_pool; i++)
+            channels.push_back(i < well_known_channels.size() ? std::string{ well_known_channels[i] } : std::format("channel{0}", i));
+
+        std::unordered_set<std::string> names;
+
+        for (auto i = 0U; i < params.name_count; i++) {
+
+            auto name = make_name(rng);
+            while (!names.insert(name).second) name += std::to_string(rng() % 10);
+
+            // Which remotes publish this name
+            std::vector<std::string_view> name_remotes{ params.remotes[rng() % params.remotes.size()] };
+            for (auto& remote : params.remotes)
+                if (remote != name_remotes.front() && uniform(rng) < params.remote_overlap)
+                    name_remotes.push_back(remote);
+
+            // Which user/channel combinations are used for it
+            std::vector<std::pair<std::string, std::string>> user_channels;
+            if (uniform(rng) < params.no_user_ratio)
+                user_channels.push_back({});
+            else {
+                // (Distinct pairs, re-drawn on collision, so that no reference is generated twice)
+                auto count = std::min<size_t>(1 + rng() % 3, users.size() * channels.size());
+                while (user_channels.size() < count) {
+                    std::pair<std::string, std::string> pair{ users[rng() % users.size()], channels[rng() % channels.size()] };
+                    if (std::find(user_channels.begin(), user_channels.end(), pair) == user_channels.end())
+                        user_channels.push_back(std::move(pair));
+                }
+            }
+
+            // Roughly one in ten names uses date-based versions (like cci.20211015)
+            auto date_based = rng() % 10 == 0;
+            auto version_count = versions_per_name(rng, params);
+            for (auto remote : name_remotes) {
+                for (auto v = 0U; v < version_count; v++) {
+                    auto version = make_version(rng, v, date_based);
+                    for (auto& [user, channel] : user_channels) {
+                        if (user_channels.size() > 1 && rng() % 3 == 0) continue;
+                        catalogue.references.push_back({ std::string{ remote }, name, version, user, channel });
+                    }
+                }
+            }
+        }
+
+        return catalogue;
+    }
+
+    void Catalogue::write(std::ostream& os) const
+    {
+        os << "# conan-gui synthetic catalogue v1\n";
+        for (auto& remote : remotes)
+            os << "remote\t" << remote.name << '\t' << remote.url << '\n';
+        for (auto& ref : references)
+            os << ref.remote << '\t' << ref.to_string() << '\n';
+    }
+
+    auto Catalogue::read(std::istream& is) -> Catalogue
+    {
+        Catalogue catalogue;
+
+        for (std::string line; std::getline(is, line);) {
+            if (line.empty() || line.front() == '#') continue;
+            auto tab = line.find('\t');
+            if (tab == std::string::npos) throw std::runtime_error(std::format("Malformed catalogue line: \"{0}\"", line));
+            if (line.compare(0, tab, "remote") == 0) {
+                auto tab2 = line.find('\t', tab + 1);
+                catalogue.remotes.push_back({ line.substr(tab + 1, tab2 - tab - 1), line.substr(tab2 + 1) });
+                continue;
+            }
+            Reference ref;
+            ref.remote = line.substr(0, tab);
+            std::string_view spec{ line };
+            spec.remove_prefix(tab + 1);
+            auto slash = spec.find('/'), at = spec.find('@');
+            ref.name = spec.substr(0, slash);
+            ref.version = spec.substr(slash + 1, at - slash - 1);
+            if (at != std::string_view::npos && at + 1 < spec.size()) {
+                auto user_channel = spec.substr(at + 1);
+                auto slash2 = user_channel.find('/');
+                ref.user = user_channel.substr(0, slash2);
+                ref.channel = user_channel.substr(slash2 + 1);
+            }
+            catalogue.references.push_back(std::move(ref));
+        }
+
+        return catalogue;
+    }
+
+    auto recipe_metadata(const Reference& ref) -> Recipe_metadata
+    {
+        std::mt19937_64 rng{ fnv1a(ref.to_string()) };
+
+        Recipe_metadata metadata;
+
+        // Long descriptions, between 20 and 120 words
+        auto word_count = 20 + rng() % 100;
+        for (auto i = 0U; i < word_count; i++) {
+            if (i > 0) metadata.description += ' ';
+            metadata.description += words[rng() % words.size()];
+        }
+
+        auto topic_count = 1 + rng() % 10;
+        for (auto i = 0U; i < topic_count; i++)
+            metadata.topics.push_back(std::string{ topic_pool[(rng() + i) % topic_pool.size()] });
+
+        metadata.license = licenses[rng() % licenses.size()];
+        metadata.author = ref.user.empty() ? "None" : std::format("{0} <{0}@example.invalid>", ref.user);
+        return metadata;
+    }
+
+    auto recipe_revision(const Reference& ref) -> std::string
+    {
+        auto hash = fnv1a(ref.to_string());
+        return std::format("{0:016x}{1:016x}", hash, fnv1a(std::to_string(hash)));
+    }
+
+    static auto quoted_topics(const Recipe_metadata& metadata, std::string_view quote) -> std::string
+    {
+        std::string topics;
+        for (auto& topic : metadata.topics) {
+            if (!topics.empty()) topics += ", ";
+            topics += std::format("{0}{1}{0}", quote, topic);
+        }
+        return topics;
+    }
+
+    auto inspect_output(const Reference& ref) -> std::string
+    {
+        auto metadata = recipe_metadata(ref);
+
+        auto out = std::format("name: {0}\n", ref.name);
+        out += std::format("version: {0}\n", ref.version);
+        out += std::format("url: https://github.com/conan-io/conan-center-index\n");
+        out += std::format("homepage: https://{0}.example.invalid\n", ref.name);
+        out += std::format("license: {0}\n", metadata.license);
+        out += std::format("author: {0}\n", metadata.author);
+        out += std::format("description: {0}\n", metadata.description);
+        out += std::format("topics: ({0})\n", quoted_topics(metadata, "'"));
+        out += "provides: None\n";
+        out += "generators: cmake\n";
+        out += "exports: None\n";
+        out += "exports_sources: None\n";
+        out += "short_paths: False\n";
+        out += "apply_env: True\n";
+        out += "build_policy: None\n";
+        out += "revision_mode: hash\n";
+        out += "settings: ('os', 'arch', 'compiler', 'build_type')\n";
+        out += "options:\n    fPIC: [True, False]\n    shared: [True, False]\n";
+        out += "default_options:\n    fPIC: True\n    shared: False\n";
+        return out;
+    }
+
+    auto conanfile_source(const Reference& ref) -> std::string
+    {
+        auto metadata = recipe_metadata(ref);
+
+        auto out = std::string{ "from conans import ConanFile, CMake\n\n\n" };
+        out += "class SyntheticConan(ConanFile):\n";
+        out += std::format("    name = \"{0}\"\n", ref.name);
+        out += std::format("    version = \"{0}\"\n", ref.version);
+        out += std::format("    license = \"{0}\"\n", metadata.license);
+        if (!ref.user.empty()) out += std::format("    author = \"{0}\"\n", metadata.author);
+        out += "    url = \"https://github.com/conan-io/conan-center-index\"\n";
+        out += std::format("    homepage = \"https://{0}.example.invalid\"\n", ref.name);
+        out += std::format("    description = \"{0}\"\n", metadata.description);
+        out += std::format("    topics = ({0}{1})\n", quoted_topics(metadata, "\""), metadata.topics.size() == 1 ? "," : "");
+        out += "    settings = \"os\", \"arch\", \"compiler\", \"build_type\"\n";
+        out += "    options = {\"shared\": [True, False], \"fPIC\": [True, False]}\n";
+        out += "    default_options = {\"shared\": False, \"fPIC\": True}\n";
+        out += "    generators = \"cmake\"\n\n";
+        out += "    def build(self):\n";
+        out += "        cmake = CMake(self)\n";
+        out += "        cmake.configure()\n";
+        out += "        cmake.build()\n";
+        return out;
+    }
+
+    bool glob_match(std::string_view pattern, std::string_view text, bool case_sensitive)
+    {
+        auto eq = [case_sensitive](char a, char b) {
+            return case_sensitive ? a == b : std::tolower((unsigned char)a) == std::tolower((unsigned char)b);
+        };
+
+        // Iterative matcher with single-star backtracking
+        size_t p = 0, t = 0, star = std::string_view::npos, mark = 0;
+        while (t < text.size()) {
+            if (p < pattern.size() && (pattern[p] == '?' || eq(pattern[p], text[t]))) { ++p; ++t; }
+            else if (p < pattern.size() && pattern[p] == '*') { star = p++; mark = t; }
+            else if (star != std::string_view::npos) { p = star + 1; t = ++mark; }
+            else return false;
+        }
+        while (p < pattern.size() && pattern[p] == '*') ++p;
+        return p == pattern.size();
+    }
+
+} // ns Synthetic
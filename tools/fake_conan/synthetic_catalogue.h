@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <ostream>
+#include <istream>
+
+
+/**
+ * Synthetic Conan catalogue, used to reproduce scans of (very) large remotes offline.
+ *
+ * The catalogue only stores remotes and references; the metadata returned by "inspect" is derived
+ * deterministically from the reference itself, so a 1M-reference catalogue stays a plain text file.
+ */
+namespace Synthetic {
+
+    struct Remote {
+        std::string name;
+        std::string url;
+    };
+
+    struct Reference {
+        std::string remote;
+        std::string name;
+        std::string version;
+        std::string user;       // empty if the reference has no user/channel
+        std::string channel;
+
+        auto to_string() const -> std::string;      // "name/version@user/channel" (or "name/version@")
+    };
+
+    struct Generator_params {
+        uint64_t                    seed = 42;
+        size_t                      name_count = 10000;
+        std::vector<std::string>    remotes = { "conancenter", "internal" };
+        double                      version_alpha = 1.8;     // power-law exponent of the versions-per-name distribution
+        size_t                      max_versions = 400;
+        size_t                      user_pool = 40;
+        size_t                      channel_pool = 6;
+        double                      no_user_ratio = 0.35;    // share of references without user/channel
+        double                      remote_overlap = 0.3;    // probability that a name is also published on another remote
+    };
+
+    struct Catalogue {
+        std::vector<Remote>     remotes;
+        std::vector<Reference>  references;
+
+        static auto generate(const Generator_params&) -> Catalogue;
+
+        void write(std::ostream&) const;
+        static auto read(std::istream&) -> Catalogue;
+    };
+
+    struct Recipe_metadata {
+        std::string                 description;
+        std::string                 license;
+        std::string                 author;     // "None" if the reference has no user
+        std::vector<std::string>    topics;
+    };
+
+    // Metadata of the recipe of a reference, derived deterministically from the reference
+    auto recipe_metadata(const Reference&) -> Recipe_metadata;
+
+    // Attribute lines as printed by "conan inspect" (Conan 1.x format)
+    auto inspect_output(const Reference&) -> std::string;
+
+    // Recipe revision (32 hex digits) and conanfile.py served by the mock REST server
+    auto recipe_revision(const Reference&) -> std::string;
+    auto conanfile_source(const Reference&) -> std::string;
+
+    // Case-(in)sensitive glob matching, supporting '*' and '?' like conan's fnmatch().
+    bool glob_match(std::string_view pattern, std::string_view text, bool case_sensitive);
+
+} // ns Synthetic